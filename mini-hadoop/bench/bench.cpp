@@ -0,0 +1,593 @@
+// Benchmarks for the counting hot path and scaling sweeps of the MPI binary.
+// Every subcommand prints its table as CSV on stdout, or as JSON with --format json,
+// so results from two builds can be diffed; progress and notes go to stderr.
+//
+//   build/bench counter [--corpus PATH] [--replicate-mb MB] [--reps R]
+//
+// 'counter' replicates the corpus in memory to MB megabytes and counts it on one
+// thread twice: with the original std::unordered_map<std::string,uint64_t> loop
+// (one std::string per token) and with count_words_span on the interned Counter.
+//
+//   build/bench tokenize [--corpus PATH] [--replicate-mb MB] [--reps R]
+//
+// 'tokenize' checks that every classify kernel this CPU supports (scalar, sse2,
+// avx2) yields counts identical to the byte-at-a-time reference, on the corpus and
+// on random bytes (high bytes, apostrophes, tokens longer than a window), then
+// reports the throughput of each. Exits non-zero on any mismatch.
+//
+//   build/bench omp [--corpus PATH] [--replicate-mb MB] [--reps R] [--max-threads T]
+//
+// 'omp' runs count_chunk_omp at 1, 2, 4, ... T threads (default 32) and, on the same
+// per-thread partial counters, times the old one-thread merge (merge_into, copies
+// every key) against Counter::absorb (partitioned parallel merge, keys adopted).
+//
+//   build/bench micro [--corpus PATH] [--replicate-mb MB] [--reps R] [--top N]
+//
+// 'micro' times each building block of a run on one thread: count_words_span,
+// serialize_counter (plain and compressed), deserialize_counter, merge_into of one
+// counter into another half-overlapping one, and topN. Round trips are checked.
+//
+//   build/bench keys [--corpus PATH] [--replicate-mb MB] [--reps R] [--max-ngram N]
+//
+// 'keys' runs the counting pipeline for every tokenizer (ascii, utf8, raw) and
+// n-gram size 1..N (default 3) and checks it against a naive loop that joins each
+// n-gram into a std::string for an unordered_map. It also checks count_chunk_omp on 4
+// threads and a serialize round trip (hash_key must agree with the counting loop's
+// hashes). Exits non-zero on any mismatch.
+//
+//   build/bench gen --out PATH [--size-mb MB] [--vocab V] [--zipf S]
+//                   [--line-words L] [--line-dist fixed|uniform|geometric] [--seed N]
+//
+// 'gen' writes a synthetic corpus (see bench/corpus_gen.hpp).
+//
+//   build/bench sweep [--ranks 1,2,4] [--threads 1,2] [--mode static|dynamic]
+//                     [--scaling strong|weak|both] [--size-mb MB] [--work-dir DIR]
+//                     [--mpirun "mpirun --oversubscribe"] [--bin build/mpi_text_hybrid]
+//                     [gen options] [-- extra args for the binary]
+//
+// 'sweep' runs the binary for every (ranks, threads) pair via '<mpirun> -np P' with
+// OMP_NUM_THREADS=T and reads back its 'Time: ... ms' line (best of R). Strong
+// scaling counts one generated corpus of MB megabytes everywhere; weak scaling gives
+// every worker (rank x thread) MB megabytes. Speedup and efficiency are relative to
+// the first pair; weak speedup is normalized by the work, so ideal is P*T for both.
+
+#include "corpus_gen.hpp"
+#include "report.hpp"
+#include "count.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <omp.h>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct BenchArgs {
+    std::string what;
+    std::string corpus = "oliver-twist.txt";
+    size_t replicate_mb = 2048;
+    int reps = 3;
+    int max_threads = 32;
+    std::string format = "csv";
+    int top = 20;
+    int max_ngram = 3;
+    // gen / sweep
+    std::string out;
+    GenOptions gen;
+    size_t size_mb = 64;
+    std::vector<int> ranks{ 1, 2, 4 };
+    std::vector<int> threads{ 1 };
+    std::string mode = "static";
+    std::string scaling = "strong";
+    std::string mpirun = "mpirun --oversubscribe";
+    std::string bin = "build/mpi_text_hybrid";
+    std::string work_dir = "/tmp";
+    std::vector<std::string> extra;
+};
+
+std::vector<int> parse_int_list(const std::string& s) {
+    std::vector<int> v;
+    size_t at = 0;
+    while (at < s.size()) {
+        size_t comma = s.find(',', at);
+        if (comma == std::string::npos) comma = s.size();
+        if (comma > at) v.push_back(std::stoi(s.substr(at, comma - at)));
+        at = comma + 1;
+    }
+    return v;
+}
+
+BenchArgs parse_bench_args(int argc, char** argv) {
+    BenchArgs b;
+    if (argc >= 2) b.what = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        std::string s = argv[i];
+        if (s == "--corpus" && i + 1 < argc) b.corpus = argv[++i];
+        else if (s == "--replicate-mb" && i + 1 < argc) b.replicate_mb = std::stoull(argv[++i]);
+        else if (s == "--reps" && i + 1 < argc) b.reps = std::stoi(argv[++i]);
+        else if (s == "--max-threads" && i + 1 < argc) b.max_threads = std::stoi(argv[++i]);
+        else if (s == "--format" && i + 1 < argc) b.format = argv[++i];
+        else if (s == "--top" && i + 1 < argc) b.top = std::stoi(argv[++i]);
+        else if (s == "--max-ngram" && i + 1 < argc) b.max_ngram = std::stoi(argv[++i]);
+        else if (s == "--out" && i + 1 < argc) b.out = argv[++i];
+        else if (s == "--size-mb" && i + 1 < argc) b.size_mb = std::stoull(argv[++i]);
+        else if (s == "--vocab" && i + 1 < argc) b.gen.vocab = std::stoull(argv[++i]);
+        else if (s == "--zipf" && i + 1 < argc) b.gen.zipf = std::stod(argv[++i]);
+        else if (s == "--line-words" && i + 1 < argc) b.gen.line_words = std::stoull(argv[++i]);
+        else if (s == "--line-dist" && i + 1 < argc) b.gen.line_dist = argv[++i];
+        else if (s == "--seed" && i + 1 < argc) b.gen.seed = (uint32_t)std::stoul(argv[++i]);
+        else if (s == "--ranks" && i + 1 < argc) b.ranks = parse_int_list(argv[++i]);
+        else if (s == "--threads" && i + 1 < argc) b.threads = parse_int_list(argv[++i]);
+        else if (s == "--mode" && i + 1 < argc) b.mode = argv[++i];
+        else if (s == "--scaling" && i + 1 < argc) b.scaling = argv[++i];
+        else if (s == "--mpirun" && i + 1 < argc) b.mpirun = argv[++i];
+        else if (s == "--bin" && i + 1 < argc) b.bin = argv[++i];
+        else if (s == "--work-dir" && i + 1 < argc) b.work_dir = argv[++i];
+        else if (s == "--") { b.extra.assign(argv + i + 1, argv + argc); break; }
+    }
+    b.gen.bytes = b.size_mb << 20;
+    return b;
+}
+
+std::vector<char> replicate(const std::vector<char>& src, size_t bytes) {
+    std::vector<char> out;
+    if (src.empty()) return out;
+    out.reserve(bytes + src.size());
+    while (out.size() < bytes) {
+        out.insert(out.end(), src.begin(), src.end());
+        out.push_back('\n');
+    }
+    return out;
+}
+
+// The pre-Counter hot loop, kept verbatim as the baseline.
+using LegacyCounter = std::unordered_map<std::string, uint64_t>;
+void count_words_span_legacy(const char* data, size_t len, LegacyCounter& out) {
+    const char* p = data;
+    const char* end = data + len;
+    std::string tok; tok.reserve(32);
+    while (p < end) {
+        unsigned char c = (unsigned char)*p++;
+        if (is_word_char(c)) {
+            tok.push_back(lower_char(c));
+        } else if (!tok.empty()) {
+            out[std::move(tok)]++; tok.clear(); tok.reserve(32);
+        }
+    }
+    if (!tok.empty()) out[std::move(tok)]++;
+}
+
+double mib_s(size_t bytes, double ms) { return (double)bytes / (1 << 20) / (ms / 1000.0); }
+
+template <class F> double best_ms(int reps, F&& f) {
+    double best = 1e300;
+    for (int r = 0; r < reps; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    return best;
+}
+
+int bench_counter(const BenchArgs& b) {
+    auto buf = replicate(slurp_file(b.corpus), b.replicate_mb << 20);
+    std::cerr << "[bench] counter: " << buf.size() / (1 << 20) << " MiB from " << b.corpus
+              << ", best of " << b.reps << "\n";
+
+    uint64_t legacy_tokens = 0, tokens = 0;
+    size_t legacy_keys = 0, keys = 0;
+    double legacy_ms = best_ms(b.reps, [&] {
+        LegacyCounter m;
+        count_words_span_legacy(buf.data(), buf.size(), m);
+        legacy_tokens = 0;
+        for (auto& kv : m) legacy_tokens += kv.second;
+        legacy_keys = m.size();
+    });
+    double ms = best_ms(b.reps, [&] {
+        Counter m;
+        count_words_span(buf.data(), buf.size(), m);
+        tokens = 0;
+        m.for_each([&](std::string_view, uint64_t c) { tokens += c; });
+        keys = m.size();
+    });
+
+    if (tokens != legacy_tokens || keys != legacy_keys) {
+        std::cerr << "[bench] MISMATCH: legacy " << legacy_tokens << " tokens/" << legacy_keys
+                  << " keys vs " << tokens << "/" << keys << "\n";
+        return 1;
+    }
+
+    auto mtok_s = [&](double t) { return (double)tokens / (t / 1000.0) / 1e6; };
+    Report rep({ "impl", "ms", "Mtokens_per_s", "MiB_per_s" });
+    rep.row("unordered_map", legacy_ms, mtok_s(legacy_ms), mib_s(buf.size(), legacy_ms));
+    rep.row("counter", ms, mtok_s(ms), mib_s(buf.size(), ms));
+    rep.print(b.format);
+    std::cerr << "[bench] " << tokens << " tokens, " << keys << " distinct; speedup "
+              << legacy_ms / ms << "x\n";
+    return 0;
+}
+
+std::vector<std::pair<std::string, uint64_t>> sorted_counts(const Counter& c) {
+    std::vector<std::pair<std::string, uint64_t>> v;
+    c.for_each([&](std::string_view k, uint64_t n) { v.emplace_back(std::string(k), n); });
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+// Random bytes biased towards the interesting classes, plus a few giant tokens.
+std::vector<char> fuzz_bytes(size_t n, uint32_t seed) {
+    static const char alphabet[] = "aAbBzZ09'' \n\t.,-\"@[`{";
+    std::mt19937 rng(seed);
+    std::vector<char> out(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t r = rng();
+        out[i] = (r % 8 == 0) ? (char)(r >> 8) : alphabet[(r >> 8) % (sizeof(alphabet) - 1)];
+    }
+    for (size_t at : { n / 3, n / 2 }) {
+        size_t len = std::min(n - at, (size_t)(3 * tok_detail::kWindow));
+        for (size_t i = 0; i < len; ++i) out[at + i] = "aB'9"[i % 4];
+    }
+    return out;
+}
+
+int bench_tokenize(const BenchArgs& b) {
+    auto kernels = tok_detail::available_kernels();
+    int bad = 0;
+
+    // Correctness: every kernel against the byte-at-a-time reference.
+    std::vector<std::pair<std::string, std::vector<char>>> inputs;
+    inputs.emplace_back("corpus", slurp_file(b.corpus));
+    for (uint32_t seed = 1; seed <= 4; ++seed) inputs.emplace_back("fuzz" + std::to_string(seed), fuzz_bytes(1 << 20, seed));
+    for (auto& [name, buf] : inputs) {
+        Counter ref;
+        count_words_span_scalar(buf.data(), buf.size(), ref);
+        auto want = sorted_counts(ref);
+        for (auto& k : kernels) {
+            // Odd lengths and offsets so window ends and SIMD tails land everywhere.
+            for (size_t cut : { (size_t)0, (size_t)1, (size_t)63, (size_t)tok_detail::kWindow - 1 }) {
+                if (cut > buf.size()) continue;
+                Counter got;
+                auto sink = [&](const char* t, size_t n) { got.add(t, n); };
+                tokenize_with(k.fn, buf.data(), cut, sink);
+                tokenize_with(k.fn, buf.data() + cut, buf.size() - cut, sink);
+                Counter ref_cut;
+                count_words_span_scalar(buf.data(), cut, ref_cut);
+                count_words_span_scalar(buf.data() + cut, buf.size() - cut, ref_cut);
+                if (sorted_counts(got) != sorted_counts(ref_cut)) {
+                    std::cerr << "[bench] MISMATCH: kernel " << k.name << " on " << name << " cut " << cut << "\n";
+                    ++bad;
+                }
+            }
+            Counter got;
+            tokenize_with(k.fn, buf.data(), buf.size(), [&](const char* t, size_t n) { got.add(t, n); });
+            if (sorted_counts(got) != want) {
+                std::cerr << "[bench] MISMATCH: kernel " << k.name << " on " << name << "\n";
+                ++bad;
+            }
+        }
+    }
+    std::cerr << "[bench] tokenize: " << kernels.size() << " kernels x " << inputs.size()
+              << " inputs checked against scalar, " << bad << " mismatches; dispatch picks "
+              << tok_detail::best_kernel().name << "\n";
+    if (bad) return 1;
+
+    // Throughput.
+    auto buf = replicate(inputs[0].second, b.replicate_mb << 20);
+    Report rep({ "kernel", "ms", "MiB_per_s" });
+    auto report = [&](const char* name, double ms) { rep.row(name, ms, mib_s(buf.size(), ms)); };
+    report("reference", best_ms(b.reps, [&] { Counter m; count_words_span_scalar(buf.data(), buf.size(), m); }));
+    for (auto& k : kernels) {
+        report(k.name, best_ms(b.reps, [&] {
+            Counter m;
+            tokenize_with(k.fn, buf.data(), buf.size(), [&](const char* t, size_t n) { m.add(t, n); });
+        }));
+    }
+    rep.print(b.format);
+    return 0;
+}
+
+int bench_omp(const BenchArgs& b) {
+    auto buf = replicate(slurp_file(b.corpus), b.replicate_mb << 20);
+    std::cerr << "[bench] omp: " << buf.size() / (1 << 20) << " MiB from " << b.corpus
+              << ", best of " << b.reps << ", " << omp_get_num_procs() << " hardware threads\n";
+
+    Counter ref;
+    count_words_span(buf.data(), buf.size(), ref);
+    auto want = sorted_counts(ref);
+
+    // Per-thread partial counters exactly as count_chunk_omp builds them.
+    auto partials = [&](int T) {
+        std::vector<Counter> locals((size_t)T);
+#pragma omp parallel for num_threads(T)
+        for (int t = 0; t < T; ++t) {
+            size_t a = split_point(buf.data(), buf.size(), t, T);
+            size_t e = split_point(buf.data(), buf.size(), t + 1, T);
+            count_words_span(buf.data() + a, e - a, locals[(size_t)t]);
+        }
+        return locals;
+    };
+    // Time only the merge; the partials are rebuilt (untimed) for every rep.
+    auto merge_ms = [&](int T, bool parallel) {
+        double best = 1e300;
+        for (int r = 0; r < b.reps; ++r) {
+            auto locals = partials(T);
+            Counter m;
+            auto t0 = std::chrono::steady_clock::now();
+            if (parallel) m.absorb(locals, T);
+            else for (auto& l : locals) merge_into(m, l);
+            auto t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+        }
+        return best;
+    };
+
+    int bad = 0;
+    Report rep({ "threads", "count_chunk_omp_ms", "MiB_per_s", "merge_serial_ms", "merge_parallel_ms" });
+    for (int T = 1; T <= b.max_threads; T *= 2) {
+        bool ok = true;
+        double total = best_ms(b.reps, [&] {
+            Counter m = count_chunk_omp(buf.data(), buf.size(), T);
+            ok = ok && sorted_counts(m) == want;
+        });
+        if (!ok) {
+            std::cerr << "[bench] MISMATCH: count_chunk_omp at " << T << " threads\n";
+            ++bad;
+        }
+        rep.row(T, total, mib_s(buf.size(), total), merge_ms(T, false), merge_ms(T, true));
+    }
+    rep.print(b.format);
+    return bad ? 1 : 0;
+}
+
+int bench_micro(const BenchArgs& b) {
+    auto buf = replicate(slurp_file(b.corpus), b.replicate_mb << 20);
+    std::cerr << "[bench] micro: " << buf.size() / (1 << 20) << " MiB from " << b.corpus
+              << ", best of " << b.reps << "\n";
+    Report rep({ "op", "ms", "keys", "bytes", "MiB_per_s" });
+
+    Counter m;
+    double ms = best_ms(b.reps, [&] { m.clear(); count_words_span(buf.data(), buf.size(), m); });
+    rep.row("count_words_span", ms, m.size(), buf.size(), mib_s(buf.size(), ms));
+    const auto want = sorted_counts(m);
+
+    int bad = 0;
+    for (bool compress : { false, true }) {
+        const char* suffix = compress ? "_lz" : "";
+        std::vector<char> blob;
+        ms = best_ms(b.reps, [&] { blob.clear(); serialize_counter(m, blob, compress); });
+        rep.row(std::string("serialize_counter") + suffix, ms, m.size(), blob.size(), mib_s(blob.size(), ms));
+        Counter back;
+        ms = best_ms(b.reps, [&] { deserialize_counter(blob.data(), blob.size(), back); });
+        rep.row(std::string("deserialize_counter") + suffix, ms, back.size(), blob.size(), mib_s(blob.size(), ms));
+        if (sorted_counts(back) != want) {
+            std::cerr << "[bench] MISMATCH: serialize/deserialize round trip" << suffix << "\n";
+            ++bad;
+        }
+    }
+
+    // Two halves of the input share most of their vocabulary, like two ranks' partials.
+    const size_t mid = split_point(buf.data(), buf.size(), 1, 2);
+    Counter right;
+    count_words_span(buf.data() + mid, buf.size() - mid, right);
+    double best = 1e300;
+    for (int r = 0; r < b.reps; ++r) {
+        Counter left;
+        count_words_span(buf.data(), mid, left);
+        auto t0 = std::chrono::steady_clock::now();
+        merge_into(left, right);
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+        if (r == 0 && sorted_counts(left) != want) {
+            std::cerr << "[bench] MISMATCH: merge_into\n";
+            ++bad;
+        }
+    }
+    rep.row("merge_into", best, right.size(), "", "");
+
+    std::vector<std::pair<std::string, uint64_t>> top;
+    ms = best_ms(b.reps, [&] { top = topN(m, b.top); });
+    rep.row("topN_" + std::to_string(b.top), ms, m.size(), "", "");
+
+    rep.print(b.format);
+    return bad ? 1 : 0;
+}
+
+int bench_keys(const BenchArgs& b) {
+    auto buf = replicate(slurp_file(b.corpus), b.replicate_mb << 20);
+    std::cerr << "[bench] keys: " << buf.size() / (1 << 20) << " MiB from " << b.corpus
+              << ", best of " << b.reps << "\n";
+    CountOptions& o = count_options();
+
+    int bad = 0;
+    Report rep({ "tokenizer", "ngram", "naive_ms", "count_ms", "MiB_per_s", "keys", "speedup" });
+    const std::pair<const char*, TokenizerKind> kinds[] = { { "ascii", TOK_ASCII }, { "utf8", TOK_UTF8 }, { "raw", TOK_RAW } };
+    for (auto [name, kind] : kinds) {
+        for (int n = 1; n <= std::min(b.max_ngram, kMaxNgram); ++n) {
+            o.tokenizer = kind;
+            o.ngram = n;
+            cut_options().lines = n > 1;
+
+            // Baseline: words of each line into strings, every n-gram joined.
+            std::unordered_map<std::string, uint64_t> naive;
+            double naive_ms = best_ms(b.reps, [&] {
+                naive.clear();
+                std::vector<std::string> line;
+                for (size_t pos = 0; pos < buf.size();) {
+                    const void* nl = std::memchr(buf.data() + pos, '\n', buf.size() - pos);
+                    const size_t e = nl ? (size_t)((const char*)nl - buf.data()) : buf.size();
+                    line.clear();
+                    tokenize_as(kind, buf.data() + pos, e - pos, [&](const char* t, size_t len) { line.emplace_back(t, len); });
+                    for (size_t i = 0; i + (size_t)n <= line.size(); ++i) {
+                        std::string key = line[i];
+                        for (int j = 1; j < n; ++j) key += ' ' + line[i + (size_t)j];
+                        ++naive[key];
+                    }
+                    pos = e + 1;
+                }
+            });
+            std::vector<std::pair<std::string, uint64_t>> want(naive.begin(), naive.end());
+            std::sort(want.begin(), want.end());
+
+            Counter m;
+            double ms = best_ms(b.reps, [&] { m.clear(); count_words_span(buf.data(), buf.size(), m); });
+            const std::string what = std::string(name) + " ngram " + std::to_string(n);
+            if (sorted_counts(m) != want) { std::cerr << "[bench] MISMATCH: count_words_span, " << what << "\n"; ++bad; }
+            if (sorted_counts(count_chunk_omp(buf.data(), buf.size(), 4)) != want) {
+                std::cerr << "[bench] MISMATCH: count_chunk_omp on 4 threads, " << what << "\n";
+                ++bad;
+            }
+            // Deserialized slots hash with hash_key; merging them into the counted table
+            // (stored hashes) must hit every existing key.
+            std::vector<char> blob;
+            serialize_counter(m, blob);
+            Counter back;
+            deserialize_counter(blob.data(), blob.size(), back);
+            const size_t before = m.size();
+            merge_into(m, back);
+            if (m.size() != before) { std::cerr << "[bench] MISMATCH: hash_key vs counting hashes, " << what << "\n"; ++bad; }
+
+            rep.row(name, n, naive_ms, ms, mib_s(buf.size(), ms), before, naive_ms / ms);
+        }
+    }
+    rep.print(b.format);
+    return bad ? 1 : 0;
+}
+
+int bench_gen(const BenchArgs& b) {
+    if (b.out.empty()) {
+        std::cerr << "[bench] gen: --out PATH is required\n";
+        return 1;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    size_t n = generate_corpus(b.out, b.gen);
+    auto t1 = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    Report rep({ "path", "bytes", "vocab", "zipf", "line_words", "line_dist", "seed", "ms" });
+    rep.row(b.out, n, b.gen.vocab, b.gen.zipf, b.gen.line_words, b.gen.line_dist, b.gen.seed, ms);
+    rep.print(b.format);
+    return 0;
+}
+
+std::string shell_quote(const std::string& s) {
+    std::string o = "'";
+    for (char c : s) {
+        if (c == '\'') o += "'\\''";
+        else o += c;
+    }
+    return o + "'";
+}
+
+// Runs one job and returns the 'Time: X ms' it printed, or a negative value.
+double run_job(const std::string& cmd) {
+    FILE* p = ::popen(cmd.c_str(), "r");
+    if (!p) return -1;
+    double ms = -1;
+    char line[4096];
+    while (std::fgets(line, sizeof line, p)) {
+        std::string s = line;
+        if (s.rfind("Time: ", 0) == 0) ms = std::stod(s.substr(6));
+    }
+    int rc = ::pclose(p);
+    return rc == 0 ? ms : -1;
+}
+
+int bench_sweep(const BenchArgs& b) {
+    if (b.ranks.empty() || b.threads.empty()) {
+        std::cerr << "[bench] sweep: --ranks and --threads need at least one value\n";
+        return 1;
+    }
+    std::vector<std::string> kinds;
+    if (b.scaling == "strong" || b.scaling == "both") kinds.push_back("strong");
+    if (b.scaling == "weak" || b.scaling == "both") kinds.push_back("weak");
+    if (kinds.empty()) {
+        std::cerr << "[bench] sweep: --scaling must be strong, weak or both\n";
+        return 1;
+    }
+
+    // One generated corpus per size, removed when the sweep ends.
+    std::vector<std::pair<size_t, std::string>> corpora;
+    auto corpus_of = [&](size_t mb) {
+        for (auto& [sz, path] : corpora) if (sz == mb) return path;
+        GenOptions g = b.gen;
+        g.bytes = mb << 20;
+        std::string path = (std::filesystem::path(b.work_dir) /
+                            ("mh_sweep_" + std::to_string(::getpid()) + "_" + std::to_string(mb) + "mb.txt")).string();
+        std::cerr << "[bench] sweep: generating " << mb << " MiB corpus " << path << "\n";
+        generate_corpus(path, g);
+        corpora.emplace_back(mb, path);
+        return path;
+    };
+
+    std::string extra;
+    for (auto& a : b.extra) extra += " " + shell_quote(a);
+
+    Report rep({ "scaling", "mode", "ranks", "threads", "MiB", "ms", "MiB_per_s", "speedup", "efficiency" });
+    int bad = 0;
+    for (auto& kind : kinds) {
+        double base_ms = 0;
+        size_t base_mb = 0, base_workers = 0;
+        for (int P : b.ranks)
+            for (int T : b.threads) {
+                const size_t workers = (size_t)P * (size_t)T;
+                const size_t mb = kind == "strong" ? b.size_mb : b.size_mb * workers;
+                const std::string cmd = "OMP_NUM_THREADS=" + std::to_string(T) + " " + b.mpirun + " -np " +
+                                        std::to_string(P) + " " + shell_quote(b.bin) + " " + b.mode + " " +
+                                        shell_quote(corpus_of(mb)) + " --top 1" + extra + " 2>&1";
+                std::cerr << "[bench] sweep: " << cmd << "\n";
+                double ms = 1e300;
+                for (int r = 0; r < b.reps; ++r) {
+                    double t = run_job(cmd);
+                    if (t < 0) { ms = -1; break; }
+                    ms = std::min(ms, t);
+                }
+                if (ms < 0) {
+                    std::cerr << "[bench] sweep: job failed or printed no Time line\n";
+                    ++bad;
+                    continue;
+                }
+                if (!base_workers) { base_ms = ms; base_mb = mb; base_workers = workers; }
+                // Work done per ms relative to the first pair; ideal is workers / base_workers.
+                const double speedup = (base_ms / ms) * ((double)mb / (double)base_mb);
+                const double ideal = (double)workers / (double)base_workers;
+                rep.row(kind, b.mode, P, T, mb, ms, mib_s(mb << 20, ms), speedup, speedup / ideal);
+            }
+    }
+    for (auto& [sz, path] : corpora) std::remove(path.c_str());
+    rep.print(b.format);
+    return bad ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchArgs b = parse_bench_args(argc, argv);
+    if (b.what == "counter") return bench_counter(b);
+    if (b.what == "tokenize") return bench_tokenize(b);
+    if (b.what == "omp") return bench_omp(b);
+    if (b.what == "micro") return bench_micro(b);
+    if (b.what == "keys") return bench_keys(b);
+    if (b.what == "gen") return bench_gen(b);
+    if (b.what == "sweep") return bench_sweep(b);
+    std::cerr << "Usage:\n"
+              << "  " << argv[0] << " counter  [--corpus PATH] [--replicate-mb MB] [--reps R]\n"
+              << "  " << argv[0] << " tokenize [--corpus PATH] [--replicate-mb MB] [--reps R]\n"
+              << "  " << argv[0] << " omp      [--corpus PATH] [--replicate-mb MB] [--reps R] [--max-threads T]\n"
+              << "  " << argv[0] << " micro    [--corpus PATH] [--replicate-mb MB] [--reps R] [--top N]\n"
+              << "  " << argv[0] << " keys     [--corpus PATH] [--replicate-mb MB] [--reps R] [--max-ngram N]\n"
+              << "  " << argv[0] << " gen      --out PATH [--size-mb MB] [--vocab V] [--zipf S] [--line-words L]\n"
+              << "                 [--line-dist fixed|uniform|geometric] [--seed N]\n"
+              << "  " << argv[0] << " sweep    [--ranks 1,2,4] [--threads 1,2] [--mode static|dynamic]\n"
+              << "                 [--scaling strong|weak|both] [--size-mb MB] [--reps R] [--work-dir DIR]\n"
+              << "                 [--mpirun CMD] [--bin PATH] [gen options] [-- extra args]\n"
+              << "every subcommand also takes --format csv|json\n";
+    return 1;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Synthetic corpus: word ranks drawn from a Zipf(s) distribution over a vocabulary
+// of V random lowercase words (length 1..14, short words more likely), written as
+// lines whose word count follows the chosen distribution:
+//
+//   fixed      every line has L words
+//   uniform    1 .. 2L-1 words
+//   geometric  mean L words (long tail of long lines)
+//
+// Deterministic for a given seed, so runs on different builds see the same bytes.
+struct GenOptions {
+    size_t bytes = 64 << 20;
+    size_t vocab = 100000;
+    double zipf = 1.1;
+    size_t line_words = 12;
+    std::string line_dist = "uniform";
+    uint32_t seed = 42;
+};
+
+inline std::vector<std::string> gen_vocabulary(size_t V, std::mt19937_64& rng) {
+    std::vector<std::string> words;
+    words.reserve(V);
+    std::geometric_distribution<int> len(0.25);
+    std::uniform_int_distribution<int> letter(0, 25);
+    for (size_t i = 0; i < V; ++i) {
+        // A rank suffix keeps every word distinct however the letters fall.
+        std::string w;
+        int n = 1 + std::min(len(rng), 9);
+        for (int k = 0; k < n; ++k) w.push_back((char)('a' + letter(rng)));
+        size_t r = i;
+        do { w.push_back((char)('a' + r % 26)); r /= 26; } while (r);
+        words.push_back(std::move(w));
+    }
+    return words;
+}
+
+// Writes about o.bytes bytes to 'path'; returns the bytes written.
+inline size_t generate_corpus(const std::string& path, const GenOptions& o) {
+    std::mt19937_64 rng(o.seed);
+    auto words = gen_vocabulary(std::max<size_t>(1, o.vocab), rng);
+
+    // Zipf CDF over ranks 1..V.
+    std::vector<double> cdf(words.size());
+    double acc = 0;
+    for (size_t r = 0; r < words.size(); ++r) cdf[r] = acc += 1.0 / std::pow((double)(r + 1), o.zipf);
+    std::uniform_real_distribution<double> u(0.0, acc);
+
+    const size_t L = std::max<size_t>(1, o.line_words);
+    std::uniform_int_distribution<size_t> uni(1, 2 * L - 1);
+    std::geometric_distribution<size_t> geo(1.0 / (double)L);
+    auto line_len = [&]() -> size_t {
+        if (o.line_dist == "fixed") return L;
+        if (o.line_dist == "geometric") return 1 + geo(rng);
+        return uni(rng);
+    };
+
+    std::ofstream f(path, std::ios::binary);
+    if (!f) throw std::runtime_error("Failed to create: " + path);
+    std::string line;
+    size_t written = 0;
+    while (written < o.bytes) {
+        line.clear();
+        for (size_t k = 0, n = line_len(); k < n; ++k) {
+            size_t r = (size_t)(std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin());
+            if (k) line.push_back(' ');
+            line += words[std::min(r, words.size() - 1)];
+        }
+        line.push_back('\n');
+        f.write(line.data(), (std::streamsize)line.size());
+        written += line.size();
+    }
+    return written;
+}
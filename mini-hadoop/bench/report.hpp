@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Benchmark results as a table: printed as CSV (default) or, with --format json, as a
+// JSON array of objects with one key per column, so runs can be diffed between builds.
+struct Report {
+    std::vector<std::string> cols;
+    std::vector<std::vector<std::string>> rows;
+
+    explicit Report(std::vector<std::string> c) : cols(std::move(c)) {}
+
+    template <class... T> void row(const T&... v) { rows.push_back({ cell(v)... }); }
+
+    void print(const std::string& format, std::ostream& os = std::cout) const {
+        if (format == "json") {
+            os << "[\n";
+            for (size_t r = 0; r < rows.size(); ++r) {
+                os << "  {";
+                for (size_t c = 0; c < cols.size(); ++c)
+                    os << (c ? ", " : "") << quote(cols[c]) << ": " << json_value(rows[r][c]);
+                os << "}" << (r + 1 < rows.size() ? "," : "") << "\n";
+            }
+            os << "]\n";
+            return;
+        }
+        for (size_t c = 0; c < cols.size(); ++c) os << (c ? "," : "") << cols[c];
+        os << "\n";
+        for (auto& r : rows) {
+            for (size_t c = 0; c < r.size(); ++c) os << (c ? "," : "") << r[c];
+            os << "\n";
+        }
+    }
+
+private:
+    template <class T> static std::string cell(const T& v) {
+        std::ostringstream s;
+        s << v;
+        return s.str();
+    }
+    static std::string quote(const std::string& s) {
+        std::string o = "\"";
+        for (char ch : s) {
+            if (ch == '"' || ch == '\\') o += '\\';
+            o += ch;
+        }
+        return o + "\"";
+    }
+    // Numbers stay numbers; everything else becomes a string.
+    static std::string json_value(const std::string& s) {
+        if (s.empty()) return "null";
+        char* end = nullptr;
+        std::strtod(s.c_str(), &end);
+        if (*end == '\0' && s != "inf" && s != "nan" && s != "-inf") return s;
+        return quote(s);
+    }
+};
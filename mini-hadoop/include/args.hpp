@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+
+class Counter;
+
+// shared arg struct (parsed in main.cpp, consumed by every mode)
+struct Args {
+    std::string mode, path;
+    int topN = 20;
+    int chunk_lines = 400;      // dynamic only (--schedule lines)
+    std::string schedule = "lines"; // dynamic only: lines | bytes | guided | adaptive | steal
+    size_t chunk_bytes = 256 << 10; // dynamic only: chunk size (bytes), minimum for guided/adaptive
+    int prefetch = 2;           // dynamic only: chunks in flight per worker
+    bool accumulate = false;    // dynamic only: workers keep counts, send acks
+    size_t flush_bytes = 0;     // dynamic --accumulate: ship a delta past this size (0 = at stop only)
+    int bar_width = 50;
+    int progress_ms = 250;          // dynamic only: dashboard interval (0 = off)
+    std::string status_file;        // dynamic only: JSON progress snapshot for an external viewer
+    std::string checkpoint_path;    // dynamic only: merged counts + completed chunk ids
+    int checkpoint_ms = 60000;      // --checkpoint: interval between writes
+    bool resume = false;            // --checkpoint: skip the chunks it already covers
+    int worker_timeout_ms = 0;      // dynamic only: reassign a silent worker's chunks (0 = never)
+    std::string ingest = "scatter"; // static only: scatter | mmap
+    bool node_aware = false;        // static only: one input copy + one counter per node
+    bool pipeline = false;          // static only: overlap read/scatter, count and reduce per block
+    size_t block_bytes = 4 << 20;   // --pipeline: bytes per rank per round
+    size_t approx = 0;              // static only: Space-Saving entries (0 = exact counts)
+    size_t cms_width = 1 << 16;     // --approx: Count-Min sketch width
+    size_t cms_depth = 4;           // --approx: Count-Min sketch depth
+    std::string reduce = "gather";  // static, dynamic --accumulate: gather | tree | shuffle
+    bool compress = false;          // LZ-compress serialized counters on the wire
+    std::string tokenizer = "ascii"; // ascii | utf8 | raw
+    int ngram = 1;                  // words per counted key (n-grams never cross a line)
+    std::string stopwords_path;     // words in this file; keys containing one are not counted
+    bool stream = false;            // read the input front to back in windows (path "-" = stdin)
+    size_t window_bytes = 64 << 20; // --stream: read size (static: one scatter round per window);
+                                    // multi-file static: piece size read ahead of counting
+    std::string index_path;         // merge the final counts into this index (index.hpp)
+    std::string stats_path;         // --stats: per-phase / per-rank JSON summary ("-" = stdout)
+    std::string trace_path;         // --trace: Chrome trace-event timeline
+    bool multi_input = false;       // derived: <corpus> is a directory, glob or @manifest
+};
+
+Args parse_args(int rank, int argc, char** argv);
+
+// Entries each rank's counter has to keep through the reduction: the top N, or
+// all of them (-1) when --index needs the full counts.
+inline int reduce_top(const Args& a) { return a.index_path.empty() ? a.topN : -1; }
+
+// Rank 0, end of a run: prints the top N and the time, then commits --index.
+void finish_run(const Counter& global, const Args& a, const char* label, double ms);
@@ -0,0 +1,114 @@
+#pragma once
+#include "utils.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ------------ dynamic-mode checkpoints (--checkpoint, --resume) ------------
+// A checkpoint is the master's merged Counter plus the set of chunk ids merged into
+// it, tagged with a plan string that says how the input was cut into chunks (path,
+// size, schedule options). A chunk id only names the same bytes under the same
+// plan, so --resume refuses a checkpoint whose plan differs. Layout (integers are
+// varints):
+//
+//   "MHCK" u8 version | plan length, plan | run count, (gap, length) per run |
+//   counter length, serialize_counter blob (LZ-compressed)
+//
+// Runs are maximal ranges of consecutive completed ids, each gap measured from the
+// end of the previous run. The file is written to PATH.tmp and renamed over PATH,
+// so a crash during a write leaves the previous checkpoint intact.
+
+constexpr uint8_t kCheckpointVersion = 1;
+
+// Completed chunk ids. Ids are issued densely from 0, so a flag per id is enough.
+class DoneSet {
+public:
+    bool contains(int64_t id) const { return id >= 0 && (size_t)id < f_.size() && f_[(size_t)id]; }
+    void add(int64_t id) {
+        if ((size_t)id >= f_.size()) f_.resize((size_t)id + 1, 0);
+        n_ += !f_[(size_t)id];
+        f_[(size_t)id] = 1;
+    }
+    size_t count() const { return n_; }
+
+    void encode(std::vector<char>& out) const {
+        std::vector<std::pair<uint64_t, uint64_t>> runs;
+        for (size_t i = 0; i < f_.size();) {
+            if (!f_[i]) { ++i; continue; }
+            size_t j = i;
+            while (j < f_.size() && f_[j]) ++j;
+            runs.emplace_back(i, j - i);
+            i = j;
+        }
+        put_varint(out, runs.size());
+        uint64_t end = 0;
+        for (auto& [start, len] : runs) {
+            put_varint(out, start - end);
+            put_varint(out, len);
+            end = start + len;
+        }
+    }
+
+    void decode(const char*& p, const char* e) {
+        uint64_t n = get_varint(p, e), end = 0;
+        for (uint64_t r = 0; r < n; ++r) {
+            uint64_t start = end + get_varint(p, e), len = get_varint(p, e);
+            for (uint64_t id = start; id < start + len; ++id) add((int64_t)id);
+            end = start + len;
+        }
+    }
+
+private:
+    std::vector<char> f_;
+    size_t n_ = 0;
+};
+
+inline void write_checkpoint(const std::string& path, const std::string& plan, const DoneSet& done,
+                             const Counter& c) {
+    std::vector<char> out = { 'M', 'H', 'C', 'K', (char)kCheckpointVersion };
+    put_varint(out, plan.size());
+    out.insert(out.end(), plan.begin(), plan.end());
+    done.encode(out);
+    std::vector<char> blob;
+    serialize_counter(c, blob, true);
+    put_varint(out, blob.size());
+    out.insert(out.end(), blob.begin(), blob.end());
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f || !f.write(out.data(), (std::streamsize)out.size()))
+            throw std::runtime_error("Failed to write checkpoint: " + tmp);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Failed to rename checkpoint to: " + path);
+}
+
+// Loads a checkpoint into 'done' and 'c'. Returns false if 'path' does not exist
+// (a first run with --resume starts from scratch); throws if the file is corrupt or
+// was written for a different plan.
+inline bool read_checkpoint(const std::string& path, const std::string& plan, DoneSet& done, Counter& c) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    std::vector<char> in((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    const char* p = in.data();
+    const char* e = p + in.size();
+    if (in.size() < 5 || std::string(p, 4) != "MHCK") throw std::runtime_error("Not a checkpoint: " + path);
+    if ((uint8_t)p[4] != kCheckpointVersion) throw std::runtime_error("Unsupported checkpoint version: " + path);
+    p += 5;
+    size_t len = get_varint(p, e);
+    if ((size_t)(e - p) < len) throw std::runtime_error("Truncated checkpoint: " + path);
+    std::string saved(p, len);
+    p += len;
+    if (saved != plan)
+        throw std::runtime_error("Checkpoint " + path + " was written for a different input, chunking or key setup:\n  saved: " +
+                                 saved + "\n  now:   " + plan);
+    done.decode(p, e);
+    len = get_varint(p, e);
+    if ((size_t)(e - p) != len) throw std::runtime_error("Truncated checkpoint: " + path);
+    deserialize_counter(p, len, c);
+    return true;
+}
@@ -0,0 +1,264 @@
+#pragma once
+#include <mpi.h>
+
+#include "stats.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+// ------------ large-count byte transfers ------------
+// MPI counts and displacements are 'int', so any single transfer over 2 GiB
+// silently overflows. Everything that moves corpus bytes or serialized counters
+// goes through these helpers instead: sizes travel as 64-bit values, and any
+// transfer bigger than kMaxMsgBytes is split into in-order pieces (MPI keeps
+// messages between the same pair/tag/comm ordered). Bytes moved are tallied in
+// stats() (see stats.hpp); the self-copy of a collective is not counted.
+
+static_assert(sizeof(size_t) == sizeof(uint64_t), "sizes travel as MPI_UINT64_T");
+
+#ifndef MH_MAX_MSG_BYTES
+#define MH_MAX_MSG_BYTES (size_t(1) << 30)
+#endif
+constexpr size_t kMaxMsgBytes = MH_MAX_MSG_BYTES;
+
+// Tag reserved for the split point-to-point fallback of the collectives below.
+constexpr int TAG_BULK = 900;
+
+inline void send_bytes(const char* p, size_t n, int dest, int tag, MPI_Comm comm) {
+    stats().bytes_sent += n;
+    for (size_t off = 0; off < n; off += kMaxMsgBytes) {
+        int piece = (int)std::min(kMaxMsgBytes, n - off);
+        MPI_Send(p + off, piece, MPI_CHAR, dest, tag, comm);
+    }
+}
+
+inline void recv_bytes(char* p, size_t n, int src, int tag, MPI_Comm comm) {
+    stats().bytes_recv += n;
+    for (size_t off = 0; off < n; off += kMaxMsgBytes) {
+        int piece = (int)std::min(kMaxMsgBytes, n - off);
+        MPI_Recv(p + off, piece, MPI_CHAR, src, tag, comm, MPI_STATUS_IGNORE);
+    }
+}
+
+// Non-blocking variant: appends one request per piece to 'reqs'.
+inline void isend_bytes(const char* p, size_t n, int dest, int tag, MPI_Comm comm,
+                        std::vector<MPI_Request>& reqs) {
+    stats().bytes_sent += n;
+    for (size_t off = 0; off < n; off += kMaxMsgBytes) {
+        int piece = (int)std::min(kMaxMsgBytes, n - off);
+        reqs.emplace_back();
+        MPI_Isend(p + off, piece, MPI_CHAR, dest, tag, comm, &reqs.back());
+    }
+}
+
+inline void irecv_bytes(char* p, size_t n, int src, int tag, MPI_Comm comm,
+                        std::vector<MPI_Request>& reqs) {
+    stats().bytes_recv += n;
+    for (size_t off = 0; off < n; off += kMaxMsgBytes) {
+        int piece = (int)std::min(kMaxMsgBytes, n - off);
+        reqs.emplace_back();
+        MPI_Irecv(p + off, piece, MPI_CHAR, src, tag, comm, &reqs.back());
+    }
+}
+
+// True if every count/displacement fits a single int-counted collective.
+inline bool fits_int_collective(const std::vector<size_t>& counts, const std::vector<size_t>& displs) {
+    for (size_t i = 0; i < counts.size(); ++i)
+        if (counts[i] > kMaxMsgBytes || displs[i] + counts[i] > kMaxMsgBytes) return false;
+    return true;
+}
+
+// MPI_Scatterv over bytes with 64-bit counts. 'counts'/'displs' are only read on root;
+// every rank passes its own 'recvcount'.
+inline void scatterv_bytes(const char* sendbuf, const std::vector<size_t>& counts,
+                           const std::vector<size_t>& displs, char* recvbuf, size_t recvcount,
+                           int root, MPI_Comm comm) {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int small = rank == root ? (int)fits_int_collective(counts, displs) : 0;
+    MPI_Bcast(&small, 1, MPI_INT, root, comm);
+
+    if (small) {
+        std::vector<int> c, d;
+        if (rank == root) {
+            c.assign(counts.begin(), counts.end());
+            d.assign(displs.begin(), displs.end());
+            for (int r = 0; r < size; ++r) if (r != root) stats().bytes_sent += counts[r];
+        } else {
+            stats().bytes_recv += recvcount;
+        }
+        MPI_Scatterv(sendbuf, c.data(), d.data(), MPI_CHAR,
+                     recvbuf, (int)recvcount, MPI_CHAR, root, comm);
+        return;
+    }
+
+    if (rank == root) {
+        std::vector<MPI_Request> reqs;
+        for (int r = 0; r < size; ++r) {
+            if (r == root) continue;
+            isend_bytes(sendbuf + displs[r], counts[r], r, TAG_BULK, comm, reqs);
+        }
+        if (counts[root]) std::memcpy(recvbuf, sendbuf + displs[root], counts[root]);
+        MPI_Waitall((int)reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+    } else {
+        recv_bytes(recvbuf, recvcount, root, TAG_BULK, comm);
+    }
+}
+
+// Variable-size gather of byte blobs to root with 64-bit sizes. On root, 'recvbuf'
+// receives all blobs back to back, with 'sizes'/'displs' describing each rank's slice.
+inline void gatherv_bytes(const char* sendbuf, size_t sendcount, std::vector<char>& recvbuf,
+                          std::vector<size_t>& sizes, std::vector<size_t>& displs,
+                          int root, MPI_Comm comm) {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    uint64_t mine = sendcount;
+    sizes.assign(size, 0);
+    displs.assign(size, 0);
+    MPI_Gather(&mine, 1, MPI_UINT64_T, sizes.data(), 1, MPI_UINT64_T, root, comm);
+
+    int small = 0;
+    if (rank == root) {
+        for (int r = 1; r < size; ++r) displs[r] = displs[r - 1] + sizes[r - 1];
+        recvbuf.resize(displs[size - 1] + sizes[size - 1]);
+        small = (int)fits_int_collective(sizes, displs);
+    }
+    MPI_Bcast(&small, 1, MPI_INT, root, comm);
+
+    if (small) {
+        std::vector<int> c, d;
+        if (rank == root) {
+            c.assign(sizes.begin(), sizes.end());
+            d.assign(displs.begin(), displs.end());
+            for (int r = 0; r < size; ++r) if (r != root) stats().bytes_recv += sizes[r];
+        } else {
+            stats().bytes_sent += sendcount;
+        }
+        MPI_Gatherv(sendbuf, (int)sendcount, MPI_CHAR,
+                    rank == root ? recvbuf.data() : nullptr,
+                    c.data(), d.data(), MPI_CHAR, root, comm);
+        return;
+    }
+
+    if (rank == root) {
+        std::vector<MPI_Request> reqs;
+        for (int r = 0; r < size; ++r) {
+            if (r == root) continue;
+            irecv_bytes(recvbuf.data() + displs[r], sizes[r], r, TAG_BULK, comm, reqs);
+        }
+        if (sendcount) std::memcpy(recvbuf.data() + displs[root], sendbuf, sendcount);
+        MPI_Waitall((int)reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+    } else {
+        send_bytes(sendbuf, sendcount, root, TAG_BULK, comm);
+    }
+}
+
+// MPI_Alltoallv over bytes with 64-bit counts. sendbufs[r] goes to rank r; on return
+// recvbufs[r] holds what rank r sent here. Uses the int-counted collective when every
+// rank's traffic fits, otherwise split point-to-point (all ranks agree via Allreduce).
+inline void alltoallv_bytes(const std::vector<std::vector<char>>& sendbufs,
+                            std::vector<std::vector<char>>& recvbufs, MPI_Comm comm) {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    std::vector<size_t> scount(size), rcount(size), sdisp(size, 0), rdisp(size, 0);
+    for (int r = 0; r < size; ++r) scount[r] = sendbufs[r].size();
+    MPI_Alltoall(scount.data(), 1, MPI_UINT64_T, rcount.data(), 1, MPI_UINT64_T, comm);
+    for (int r = 1; r < size; ++r) {
+        sdisp[r] = sdisp[r - 1] + scount[r - 1];
+        rdisp[r] = rdisp[r - 1] + rcount[r - 1];
+    }
+
+    recvbufs.assign(size, {});
+    for (int r = 0; r < size; ++r) recvbufs[r].resize(rcount[r]);
+
+    int small = (int)(fits_int_collective(scount, sdisp) && fits_int_collective(rcount, rdisp));
+    MPI_Allreduce(MPI_IN_PLACE, &small, 1, MPI_INT, MPI_MIN, comm);
+
+    if (small) {
+        std::vector<char> sflat(sdisp[size - 1] + scount[size - 1]);
+        std::vector<char> rflat(rdisp[size - 1] + rcount[size - 1]);
+        for (int r = 0; r < size; ++r)
+            if (scount[r]) std::memcpy(sflat.data() + sdisp[r], sendbufs[r].data(), scount[r]);
+        std::vector<int> sc(scount.begin(), scount.end()), sd(sdisp.begin(), sdisp.end());
+        std::vector<int> rc(rcount.begin(), rcount.end()), rd(rdisp.begin(), rdisp.end());
+        for (int r = 0; r < size; ++r)
+            if (r != rank) { stats().bytes_sent += scount[r]; stats().bytes_recv += rcount[r]; }
+        MPI_Alltoallv(sflat.data(), sc.data(), sd.data(), MPI_CHAR,
+                      rflat.data(), rc.data(), rd.data(), MPI_CHAR, comm);
+        for (int r = 0; r < size; ++r)
+            if (rcount[r]) std::memcpy(recvbufs[r].data(), rflat.data() + rdisp[r], rcount[r]);
+        return;
+    }
+
+    std::vector<MPI_Request> reqs;
+    for (int r = 0; r < size; ++r) {
+        if (r == rank) { recvbufs[r] = sendbufs[r]; continue; }
+        irecv_bytes(recvbufs[r].data(), rcount[r], r, TAG_BULK, comm, reqs);
+    }
+    for (int r = 0; r < size; ++r) {
+        if (r == rank) continue;
+        isend_bytes(sendbufs[r].data(), scount[r], r, TAG_BULK, comm, reqs);
+    }
+    MPI_Waitall((int)reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+}
+
+// ------------ non-blocking send queue ------------
+// Outstanding MPI_Isends plus the storage they read from. send_owned() moves the
+// buffer into the queue so it outlives the call; send_ref() is for memory that is
+// known to stay put (e.g. the corpus). reap() retires completed sends in order.
+class SendQueue {
+public:
+    SendQueue() = default;
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+    ~SendQueue() { wait_all(); }
+
+    void send_owned(std::vector<char> buf, int dest, int tag, MPI_Comm comm) {
+        q_.emplace_back();
+        Item& it = q_.back();
+        it.owned = std::move(buf);
+        isend_bytes(it.owned.data(), it.owned.size(), dest, tag, comm, it.reqs);
+    }
+
+    void send_ref(const char* p, size_t n, int dest, int tag, MPI_Comm comm) {
+        q_.emplace_back();
+        isend_bytes(p, n, dest, tag, comm, q_.back().reqs);
+    }
+
+    void reap() {
+        while (!q_.empty()) {
+            Item& it = q_.front();
+            int done = 1;
+            if (!it.reqs.empty()) MPI_Testall((int)it.reqs.size(), it.reqs.data(), &done, MPI_STATUSES_IGNORE);
+            if (!done) return;
+            q_.pop_front();
+        }
+    }
+
+    void wait_all() {
+        for (Item& it : q_)
+            if (!it.reqs.empty()) MPI_Waitall((int)it.reqs.size(), it.reqs.data(), MPI_STATUSES_IGNORE);
+        q_.clear();
+    }
+
+    size_t pending() const { return q_.size(); }
+
+private:
+    struct Item { std::vector<char> owned; std::vector<MPI_Request> reqs; };
+    std::deque<Item> q_;
+};
+
+// Small fixed-layout message (headers, metadata) as an owned byte buffer.
+template <class T> std::vector<char> pod_bytes(const T& v) {
+    std::vector<char> b(sizeof(T));
+    std::memcpy(b.data(), &v, sizeof(T));
+    return b;
+}
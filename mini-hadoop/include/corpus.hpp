@@ -0,0 +1,263 @@
+#pragma once
+#include <mpi.h>
+
+#include "comm.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <glob.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ------------ multi-file corpora ------------
+// <corpus> may name many files instead of one:
+//
+//   a directory     every regular file below it (recursive, sorted by path)
+//   a glob          "data/*.txt" (quote it so the shell leaves it alone)
+//   @manifest       one path per line, blank lines and '#' comments skipped
+//
+// A path naming an existing regular file is always that one file, even when it
+// contains glob characters.
+//
+// Work is described by pieces (path, offset, length) rather than bytes: rank 0
+// only lists the files and plans, and whoever counts a piece reads it. A piece
+// that starts or ends inside a file is cut with the next_ws rule (start at the
+// first whitespace at or after 'off' unless off == 0, end likewise), so pieces
+// of one file tile it without splitting a token. Each piece is loaded followed
+// by a '\n', so words never join across files.
+
+struct InputFile { std::string path; uint64_t size; };
+struct Piece { std::string path; uint64_t off, len; };
+using WorkUnit = std::vector<Piece>;
+
+inline bool is_multi_input(const std::string& spec) {
+    if (spec.empty() || spec == "-") return false;
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(spec, ec)) return false;   // "corpus[2024].txt"
+    if (spec[0] == '@' || spec.find_first_of("*?[") != std::string::npos) return true;
+    return std::filesystem::is_directory(spec, ec);
+}
+
+inline std::vector<InputFile> list_inputs(const std::string& spec) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> paths;
+    if (spec[0] == '@') {
+        std::ifstream m(spec.substr(1));
+        if (!m) throw std::runtime_error("Failed to open manifest: " + spec.substr(1));
+        for (std::string line; std::getline(m, line);) {
+            while (!line.empty() && std::isspace((unsigned char)line.back())) line.pop_back();
+            if (!line.empty() && line[0] != '#') paths.push_back(line);
+        }
+    } else if (fs::is_directory(spec)) {
+        for (auto& e : fs::recursive_directory_iterator(spec, fs::directory_options::skip_permission_denied))
+            if (e.is_regular_file()) paths.push_back(e.path().string());
+        std::sort(paths.begin(), paths.end());
+    } else {
+        glob_t g{};
+        if (::glob(spec.c_str(), 0, nullptr, &g) == 0)
+            for (size_t i = 0; i < g.gl_pathc; ++i) paths.emplace_back(g.gl_pathv[i]);
+        ::globfree(&g);
+    }
+
+    std::vector<InputFile> files;
+    for (auto& p : paths) {
+        std::error_code ec;
+        if (!fs::is_regular_file(p, ec)) continue;
+        uint64_t n = fs::file_size(p, ec);
+        if (!ec && n) files.push_back({ p, n });
+    }
+    if (files.empty()) throw std::runtime_error("No input files in: " + spec);
+    return files;
+}
+
+// Rank 'root' lists, everyone else receives the list (one directory scan per job).
+inline void bcast_inputs(std::vector<InputFile>& files, int root, MPI_Comm comm) {
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+    std::vector<char> blob;
+    if (rank == root)
+        for (auto& f : files) {
+            put_varint(blob, f.path.size());
+            blob.insert(blob.end(), f.path.begin(), f.path.end());
+            put_varint(blob, f.size);
+        }
+    uint64_t n = blob.size();
+    MPI_Bcast(&n, 1, MPI_UINT64_T, root, comm);
+    blob.resize(n);
+    for (size_t off = 0; off < n; off += kMaxMsgBytes)
+        MPI_Bcast(blob.data() + off, (int)std::min<size_t>(kMaxMsgBytes, n - off), MPI_CHAR, root, comm);
+    if (rank == root) return;
+    files.clear();
+    const char* p = blob.data();
+    const char* e = p + n;
+    while (p < e) {
+        size_t len = get_varint(p, e);
+        if ((size_t)(e - p) < len) throw std::runtime_error("bcast_inputs: truncated");
+        std::string path(p, len);
+        p += len;
+        files.push_back({ std::move(path), get_varint(p, e) });
+    }
+}
+
+inline uint64_t unit_bytes(const WorkUnit& u) {
+    uint64_t n = 0;
+    for (auto& p : u) n += p.len;
+    return n;
+}
+
+// Dynamic mode: files smaller than 'target' are packed together until a unit
+// reaches 'target' bytes; larger files are split into ~'target' pieces, one unit each.
+inline std::vector<WorkUnit> pack_units(const std::vector<InputFile>& files, uint64_t target) {
+    target = std::max<uint64_t>(1, target);
+    std::vector<WorkUnit> units;
+    WorkUnit cur;
+    uint64_t cur_bytes = 0;
+    for (auto& f : files) {
+        if (f.size > target) {
+            for (uint64_t off = 0; off < f.size; off += target)
+                units.push_back({ { f.path, off, std::min(target, f.size - off) } });
+            continue;
+        }
+        cur.push_back({ f.path, 0, f.size });
+        cur_bytes += f.size;
+        if (cur_bytes >= target) { units.push_back(std::move(cur)); cur.clear(); cur_bytes = 0; }
+    }
+    if (!cur.empty()) units.push_back(std::move(cur));
+    return units;
+}
+
+// Static mode: bytes [lo, hi) of the files laid end to end, as pieces of at most
+// 'max_piece' bytes (so loading can run ahead of counting in bounded memory).
+inline WorkUnit range_pieces(const std::vector<InputFile>& files, uint64_t lo, uint64_t hi, uint64_t max_piece) {
+    max_piece = std::max<uint64_t>(1, max_piece);
+    WorkUnit out;
+    uint64_t base = 0;
+    for (auto& f : files) {
+        uint64_t a = std::max(lo, base), b = std::min(hi, base + f.size);
+        for (uint64_t x = a; x < b; x += max_piece)
+            out.push_back({ f.path, x - base, std::min(max_piece, b - x) });
+        base += f.size;
+        if (base >= hi) break;
+    }
+    return out;
+}
+
+// Work unit <-> bytes (the TAG_DATA payload in dynamic mode).
+inline void encode_unit(const WorkUnit& u, std::vector<char>& out) {
+    out.clear();
+    put_varint(out, u.size());
+    for (auto& p : u) {
+        put_varint(out, p.path.size());
+        out.insert(out.end(), p.path.begin(), p.path.end());
+        put_varint(out, p.off);
+        put_varint(out, p.len);
+    }
+}
+
+inline WorkUnit decode_unit(const char* p, size_t n) {
+    const char* e = p + n;
+    WorkUnit u(get_varint(p, e));
+    for (auto& pc : u) {
+        size_t len = get_varint(p, e);
+        if ((size_t)(e - p) < len) throw std::runtime_error("decode_unit: truncated");
+        pc.path.assign(p, len);
+        p += len;
+        pc.off = get_varint(p, e);
+        pc.len = get_varint(p, e);
+    }
+    return u;
+}
+
+// Appends the token-aligned bytes of 'pc' plus a '\n' to 'out'.
+inline void load_piece(const Piece& pc, std::vector<char>& out) {
+    MappedFile f(pc.path);
+    const size_t N = f.size();
+    size_t lo = std::min<size_t>(pc.off, N), hi = std::min<size_t>(pc.off + pc.len, N);
+    if (lo) lo = next_ws(f.data(), N, lo);
+    if (hi < N) hi = next_ws(f.data(), N, hi);
+    if (lo < hi) {
+        f.advise_sequential(lo, hi);
+        out.insert(out.end(), f.data() + lo, f.data() + hi);
+    }
+    out.push_back('\n');
+}
+
+// Loads submitted units on a background thread, in order, keeping at most 'depth'
+// loaded units waiting, so file opening and reading overlap with counting. Never
+// calls MPI (MPI_THREAD_FUNNELED is enough).
+class UnitLoader {
+public:
+    explicit UnitLoader(size_t depth) : depth_(std::max<size_t>(1, depth)), th_([this] { run(); }) {}
+    UnitLoader(const UnitLoader&) = delete;
+    UnitLoader& operator=(const UnitLoader&) = delete;
+    ~UnitLoader() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+        th_.join();
+    }
+
+    void submit(WorkUnit u) {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            todo_.push_back(std::move(u));
+        }
+        cv_.notify_all();
+    }
+
+    // Bytes of the oldest submitted unit (blocks until loaded). Rethrows load errors.
+    std::vector<char> take() {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [&] { return !ready_.empty() || err_; });
+        if (ready_.empty()) std::rethrow_exception(err_);
+        std::vector<char> out = std::move(ready_.front());
+        ready_.pop_front();
+        cv_.notify_all();
+        return out;
+    }
+
+private:
+    void run() {
+        for (;;) {
+            WorkUnit u;
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [&] { return closed_ || (!todo_.empty() && ready_.size() < depth_); });
+                if (closed_) return;
+                u = std::move(todo_.front());
+                todo_.pop_front();
+            }
+            std::vector<char> buf;
+            try {
+                buf.reserve(unit_bytes(u) + u.size());
+                for (auto& pc : u) load_piece(pc, buf);
+            } catch (...) {
+                std::lock_guard<std::mutex> lk(mu_);
+                err_ = std::current_exception();
+                cv_.notify_all();
+                return;
+            }
+            std::lock_guard<std::mutex> lk(mu_);
+            ready_.push_back(std::move(buf));
+            cv_.notify_all();
+        }
+    }
+
+    size_t depth_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<WorkUnit> todo_;
+    std::deque<std::vector<char>> ready_;
+    std::exception_ptr err_;
+    bool closed_ = false;
+    std::thread th_;
+};
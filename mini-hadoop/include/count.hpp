@@ -1,56 +1,166 @@
 #pragma once
+#include "stats.hpp"
 #include "utils.hpp"
-#include <cctype>
+#include "tokenize.hpp"
 #include <omp.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
 inline bool is_word_char(unsigned char c) {
-    return std::isalnum(c) || c=='\''; // simple heuristic; keep apostrophes
-}
-inline char lower_char(unsigned char c) { return (char)std::tolower(c); }
-
-inline void count_words_span(const char* data, size_t len, Counter& out) {
-    const char* p = data;
-    const char* end = data + len;
-    std::string tok; tok.reserve(32);
-    while (p < end) {
-        unsigned char c = (unsigned char)*p++;
-        if (is_word_char(c)) {
-            tok.push_back(lower_char(c));
-        } else if (!tok.empty()) {
-            out[std::move(tok)]++; tok.clear(); tok.reserve(32);
+    return kWordChar[c]; // simple heuristic; keep apostrophes (ASCII alnum + '\'')
+}
+inline char lower_char(unsigned char c) { return kLowerChar[c]; }
+
+// ------------ tokenizer policies ------------
+// A policy turns bytes into words: run(data, len, sink) calls sink(const char*, size_t)
+// once per word, in order; the pointer is only valid during the call. Policies are
+// template parameters of the counting loop, so every combination gets its own loop.
+struct AsciiWords {  // ASCII alnum + apostrophe, lowercased (SIMD, see tokenize.hpp)
+    template <class Sink> static void run(const char* d, size_t n, Sink&& sink) { tokenize(d, n, sink); }
+};
+struct Utf8Words {   // ASCII rule plus non-ASCII letters, Unicode case folding
+    template <class Sink> static void run(const char* d, size_t n, Sink&& sink) { tokenize_utf8(d, n, sink); }
+};
+struct RawWords {    // runs of non-whitespace bytes, as they are
+    template <class Sink> static void run(const char* d, size_t n, Sink&& sink) { tokenize_raw(d, n, sink); }
+};
+
+enum TokenizerKind { TOK_ASCII, TOK_UTF8, TOK_RAW };
+
+constexpr int kMaxNgram = 5;
+
+// Process-wide counting settings, set once from the command line in main() on every
+// rank (like wire_options). Keys are 'ngram' consecutive words joined by a space.
+struct CountOptions {
+    TokenizerKind tokenizer = TOK_ASCII;
+    int ngram = 1;
+    Counter stopwords; // keys containing one of these are not counted
+};
+inline CountOptions& count_options() { static CountOptions o; return o; }
+
+// Runs the 'kind' policy over data[0..len).
+template <class Sink>
+inline void tokenize_as(TokenizerKind kind, const char* data, size_t len, Sink&& sink) {
+    switch (kind) {
+    case TOK_UTF8: Utf8Words::run(data, len, sink); break;
+    case TOK_RAW:  RawWords::run(data, len, sink); break;
+    default:       AsciiWords::run(data, len, sink); break;
+    }
+}
+
+// ------------ counting loop ------------
+// Counts every run of N consecutive words on one line as one key. The last N words
+// sit in a ring with their hashes; a key's hash is folded from those (WordHash) and
+// Counter::add_words probes and inserts word by word, so no joined string is built
+// per key. Keys containing a stop word are skipped. Returns the number of words.
+template <class Tok, int N>
+inline size_t count_keys(const char* data, size_t len, Counter& out, const Counter* stop) {
+    size_t words = 0;
+    if constexpr (N == 1) {
+        // Counter looks up by (ptr, len), so nothing here allocates for words
+        // already in the table.
+        Tok::run(data, len, [&](const char* t, size_t n) {
+            const uint64_t h = hash_bytes(t, n);
+            ++words;
+            if (!stop || !stop->get_hashed(h, t, n)) out.add_hashed(h, t, n, 1);
+        });
+    } else {
+        std::string ring[N];
+        uint64_t hashes[N];
+        int clean = 0; // words since the last stop word or line break
+        auto sink = [&](const char* t, size_t n) {
+            const size_t slot = words++ % N;
+            const uint64_t h = hash_bytes(t, n);
+            if (stop && stop->get_hashed(h, t, n)) { clean = 0; return; }
+            ring[slot].assign(t, n);
+            hashes[slot] = h;
+            if (clean < N) ++clean;
+            if (clean < N) return;
+            std::string_view w[N];
+            WordHash kh;
+            for (int j = 0; j < N; ++j) { // oldest first: slot words % N
+                const size_t s = (words + (size_t)j) % N;
+                w[j] = ring[s];
+                kh.push(hashes[s]);
+            }
+            out.add_words(kh.done(), w, N, 1);
+        };
+        // Tokenizers do not report line breaks, so they run one line at a time.
+        for (size_t pos = 0; pos < len;) {
+            const void* nl = std::memchr(data + pos, '\n', len - pos);
+            const size_t e = nl ? (size_t)((const char*)nl - data) : len;
+            clean = 0;
+            Tok::run(data + pos, e - pos, sink);
+            pos = e + 1;
         }
     }
-    if (!tok.empty()) out[std::move(tok)]++;
+    return words;
 }
 
-// Hybrid: split chunk by threads, count per-thread, merge
-inline Counter count_chunk_omp(const char* data, size_t n, int nthreads) {
-    if (n == 0) return {};
+template <class Tok>
+inline size_t count_keys_n(const char* data, size_t len, Counter& out, const CountOptions& o) {
+    const Counter* stop = o.stopwords.empty() ? nullptr : &o.stopwords;
+    switch (o.ngram) {
+    case 2: return count_keys<Tok, 2>(data, len, out, stop);
+    case 3: return count_keys<Tok, 3>(data, len, out, stop);
+    case 4: return count_keys<Tok, 4>(data, len, out, stop);
+    case 5: return count_keys<Tok, 5>(data, len, out, stop);
+    default: return count_keys<Tok, 1>(data, len, out, stop);
+    }
+}
+
+// Counts data[0..len) into 'out' with the count_options() pipeline. Returns the
+// number of words (tokens) seen.
+inline size_t count_words_span(const char* data, size_t len, Counter& out) {
+    const CountOptions& o = count_options();
+    switch (o.tokenizer) {
+    case TOK_UTF8: return count_keys_n<Utf8Words>(data, len, out, o);
+    case TOK_RAW:  return count_keys_n<RawWords>(data, len, out, o);
+    default:       return count_keys_n<AsciiWords>(data, len, out, o);
+    }
+}
+
+// Byte-at-a-time reference for the default pipeline (ASCII words, no n-grams or
+// stop words); count_words_span must produce identical counts.
+inline void count_words_span_scalar(const char* data, size_t len, Counter& out) {
+    tokenize_scalar(data, len, [&](const char* t, size_t n) { out.add(t, n); });
+}
+
+// Cut t of 'parts' over data[0..n): the nominal split advanced with next_ws (to
+// whitespace, or to a line break when keys span several words), so a key
+// straddling a split belongs wholly to the part on its left. Both neighbours
+// compute the same cut, so nothing is dropped or counted twice.
+inline size_t split_point(const char* data, size_t n, int t, int parts) {
+    size_t i = (n * (size_t)t) / (size_t)parts;
+    if (t == 0 || t == parts) return i;
+    return next_ws(data, n, i);
+}
+
+// Hybrid: split chunk by threads, count per-thread, merge into 'merged' in parallel
+// (Counter::absorb: every thread merges one hash range, keys are not copied)
+inline void count_chunk_omp(const char* data, size_t n, int nthreads, Counter& merged) {
+    if (n == 0) return;
     if (nthreads <= 0) nthreads = 1;
+    PhaseTimer timer(PH_COUNT);
     std::vector<Counter> locals((size_t)nthreads);
 
 #pragma omp parallel num_threads(nthreads)
     {
+        ThreadBusyTimer busy;
         int tid = omp_get_thread_num();
-        size_t start = (n * (size_t)tid) / (size_t)nthreads;
-        size_t end   = (n * (size_t)(tid + 1)) / (size_t)nthreads;
-
-        // Expand boundaries to avoid cutting a token in half
-        // Move start to next non-word boundary (unless tid==0)
-        if (tid != 0) {
-            while (start < end && is_word_char((unsigned char)data[start])) ++start;
-        }
-        // Move end backward to previous non-word boundary (unless last thread)
-        if (tid != nthreads - 1) {
-            while (end > start && is_word_char((unsigned char)data[end - 1])) --end;
-        }
-
-        if (start < end) count_words_span(data + start, end - start, locals[(size_t)tid]);
+        size_t start = split_point(data, n, tid, nthreads);
+        size_t end   = split_point(data, n, tid + 1, nthreads);
+        if (start < end) stats().tokens += count_words_span(data + start, end - start, locals[(size_t)tid]);
     }
 
+    merged.absorb(locals, nthreads);
+    stats().bytes_in += n;
+    stats().note_table(merged.size());
+}
+
+inline Counter count_chunk_omp(const char* data, size_t n, int nthreads) {
     Counter merged;
-    for (auto& m : locals) merge_into(merged, m);
+    count_chunk_omp(data, n, nthreads, merged);
     return merged;
 }
@@ -0,0 +1,408 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// ------------ string arena ------------
+// Bump allocator for key bytes. Keys are copied in once, on first insert, and
+// never move afterwards, so table slots can point straight at them. Each Counter
+// owns one arena, which makes the arena per-thread wherever the Counter is.
+class StringArena {
+public:
+    static constexpr size_t kBlockBytes = 64 << 10;
+
+    StringArena() = default;
+    StringArena(StringArena&& o) noexcept
+        : blocks_(std::move(o.blocks_)), cur_(std::exchange(o.cur_, nullptr)),
+          left_(std::exchange(o.left_, 0)), bytes_(std::exchange(o.bytes_, 0)),
+          reserved_(std::exchange(o.reserved_, 0)) {}
+    StringArena& operator=(StringArena&& o) noexcept {
+        blocks_ = std::move(o.blocks_);
+        cur_ = std::exchange(o.cur_, nullptr);
+        left_ = std::exchange(o.left_, 0);
+        bytes_ = std::exchange(o.bytes_, 0);
+        reserved_ = std::exchange(o.reserved_, 0);
+        return *this;
+    }
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    const char* intern(const char* s, size_t n) {
+        char* dst = alloc(n);
+        if (n) std::memcpy(dst, s, n);
+        return dst;
+    }
+
+    char* alloc(size_t n) {
+        static char empty_key;
+        if (n == 0) return &empty_key; // never hand out nullptr: it marks empty slots
+        if (n > left_) {
+            if (n > kBlockBytes / 4) {
+                // Oversized keys get a block of their own so the current block keeps its tail.
+                blocks_.emplace_back(new char[n]);
+                bytes_ += n;
+                reserved_ += n;
+                return blocks_.back().get();
+            }
+            blocks_.emplace_back(new char[kBlockBytes]);
+            reserved_ += kBlockBytes;
+            cur_ = blocks_.back().get();
+            left_ = kBlockBytes;
+        }
+        char* p = cur_;
+        cur_ += n; left_ -= n; bytes_ += n;
+        return p;
+    }
+
+    size_t bytes() const { return bytes_; }       // key bytes handed out
+    size_t reserved() const { return reserved_; } // bytes in allocated blocks
+
+    // Take over another arena's blocks. Pointers into them stay valid, so keys
+    // interned there can be referenced from this arena's owner without copying.
+    void adopt(StringArena&& o) {
+        for (auto& b : o.blocks_) blocks_.push_back(std::move(b));
+        bytes_ += o.bytes_;
+        reserved_ += o.reserved_;
+        o.blocks_.clear(); o.cur_ = nullptr; o.left_ = 0; o.bytes_ = 0; o.reserved_ = 0;
+    }
+
+    void clear() { blocks_.clear(); cur_ = nullptr; left_ = 0; bytes_ = 0; reserved_ = 0; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* cur_ = nullptr;
+    size_t left_ = 0;
+    size_t bytes_ = 0;
+    size_t reserved_ = 0;
+};
+
+// ------------ hashing ------------
+// 8 bytes at a time, finished with the murmur3 fmix64 avalanche. Slot index comes
+// from the *high* bits (see Counter::home), which fmix64 mixes well.
+inline uint64_t hash_bytes(const char* s, size_t n) {
+    constexpr uint64_t K = 0x9E3779B97F4A7C15ull;
+    uint64_t h = K ^ (n * 0xC2B2AE3D27D4EB4Full);
+    while (n >= 8) {
+        uint64_t w; std::memcpy(&w, s, 8);
+        h = (h ^ w) * K;
+        h ^= h >> 29;
+        s += 8; n -= 8;
+    }
+    if (n) {
+        uint64_t w = 0; std::memcpy(&w, s, n);
+        h = (h ^ w) * K;
+    }
+    h ^= h >> 33; h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33; h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// ------------ n-gram keys ------------
+// An n-gram key is its words joined by single spaces. Its hash is built from the
+// words' own hash_bytes values, so the counting loop hashes every token once and
+// never joins strings; hash_key gets the same value back from the joined bytes
+// (deserialization, lookups). No tokenizer ever puts a space inside a word, so a
+// key without one is a single word and hashes exactly as hash_bytes.
+struct WordHash {
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    size_t k = 0;
+
+    void push(uint64_t w) {
+        h = (h ^ w) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+        ++k;
+    }
+    uint64_t done() const {
+        uint64_t x = h ^ (k * 0xD6E8FEB86659FD93ull);
+        x ^= x >> 33; x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33; x *= 0xC4CEB9FE1A85EC53ull;
+        x ^= x >> 33;
+        return x;
+    }
+};
+
+inline uint64_t hash_words(const uint64_t* wh, size_t k) {
+    WordHash h;
+    for (size_t i = 0; i < k; ++i) h.push(wh[i]);
+    return h.done();
+}
+
+inline uint64_t hash_key(const char* s, size_t n) {
+    const char* e = s + n;
+    const char* sp = n ? (const char*)std::memchr(s, ' ', n) : nullptr;
+    if (!sp) return hash_bytes(s, n);
+    WordHash h;
+    for (;;) {
+        h.push(hash_bytes(s, (size_t)(sp - s)));
+        if (sp == e) return h.done();
+        s = sp + 1;
+        sp = (const char*)std::memchr(s, ' ', (size_t)(e - s));
+        if (!sp) sp = e;
+    }
+}
+
+// ------------ Counter ------------
+// Open-addressing (linear probing) word -> count table. Slots store the full hash
+// inline, so probing compares hashes before touching key bytes, and rehashing or
+// merging never recomputes a hash. Lookups are keyed on (const char*, len): the
+// counting loop passes a view of its token and only the first occurrence of a
+// word copies bytes (into the arena).
+class Counter {
+public:
+    struct Slot {
+        uint64_t hash = 0;
+        const char* key = nullptr; // nullptr marks an empty slot
+        uint64_t len = 0;
+        uint64_t count = 0;
+
+        std::string_view view() const { return { key, (size_t)len }; }
+    };
+
+    Counter() = default;
+    Counter(Counter&& o) noexcept
+        : slots_(std::move(o.slots_)), arena_(std::move(o.arena_)),
+          size_(std::exchange(o.size_, 0)), shift_(std::exchange(o.shift_, 64)) {}
+    Counter& operator=(Counter&& o) noexcept {
+        slots_ = std::move(o.slots_); o.slots_.clear();
+        arena_ = std::move(o.arena_);
+        size_ = std::exchange(o.size_, 0);
+        shift_ = std::exchange(o.shift_, 64);
+        return *this;
+    }
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t capacity() const { return slots_.size(); }
+    size_t arena_bytes() const { return arena_.bytes(); }
+    // Heap footprint: the slot table plus every arena block, used or not.
+    size_t memory_bytes() const { return slots_.size() * sizeof(Slot) + arena_.reserved(); }
+
+    void clear() {
+        slots_.clear();
+        arena_.clear();
+        size_ = 0; shift_ = 64;
+    }
+
+    // Make room for n keys without further rehashing.
+    void reserve(size_t n) {
+        size_t want = 16;
+        while (want * kMaxLoadNum < n * kMaxLoadDen) want <<= 1;
+        if (want > slots_.size()) rehash(want);
+    }
+
+    void add(const char* s, size_t n, uint64_t c = 1) { add_hashed(hash_key(s, n), s, n, c); }
+    void add(std::string_view k, uint64_t c = 1) { add(k.data(), k.size(), c); }
+
+    // Add with a precomputed hash (merges reuse the hash stored in the source slot).
+    void add_hashed(uint64_t h, const char* s, size_t n, uint64_t c) {
+        if ((size_ + 1) * kMaxLoadDen > slots_.size() * kMaxLoadNum) grow();
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = home(h);; i = (i + 1) & mask) {
+            Slot& sl = slots_[i];
+            if (!sl.key) {
+                sl.hash = h; sl.key = arena_.intern(s, n); sl.len = n; sl.count = c;
+                ++size_;
+                return;
+            }
+            if (sl.hash == h && sl.len == n && std::memcmp(sl.key, s, n) == 0) {
+                sl.count += c;
+                return;
+            }
+        }
+    }
+
+    // Add the n-gram w[0] + ' ' + ... + w[k-1] under h = hash_words(...). Probing
+    // compares word by word; the joined key is only built on first insert, straight
+    // into the arena.
+    void add_words(uint64_t h, const std::string_view* w, size_t k, uint64_t c) {
+        size_t n = k - 1;
+        for (size_t i = 0; i < k; ++i) n += w[i].size();
+        if ((size_ + 1) * kMaxLoadDen > slots_.size() * kMaxLoadNum) grow();
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = home(h);; i = (i + 1) & mask) {
+            Slot& sl = slots_[i];
+            if (!sl.key) {
+                char* dst = arena_.alloc(n);
+                for (size_t j = 0; j < k; ++j) {
+                    if (j) *dst++ = ' ';
+                    std::memcpy(dst, w[j].data(), w[j].size());
+                    dst += w[j].size();
+                }
+                sl.hash = h; sl.key = dst - n; sl.len = n; sl.count = c;
+                ++size_;
+                return;
+            }
+            if (sl.hash == h && sl.len == n && equal_words(sl.key, w, k)) {
+                sl.count += c;
+                return;
+            }
+        }
+    }
+
+    uint64_t get(std::string_view k) const { return get_hashed(hash_key(k.data(), k.size()), k.data(), k.size()); }
+
+    uint64_t get_hashed(uint64_t h, const char* s, size_t n) const {
+        if (slots_.empty()) return 0;
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = home(h);; i = (i + 1) & mask) {
+            const Slot& sl = slots_[i];
+            if (!sl.key) return 0;
+            if (sl.hash == h && sl.len == n && std::memcmp(sl.key, s, n) == 0) return sl.count;
+        }
+    }
+
+    // Merge every Counter in 'srcs' into this one on up to 'nthreads' threads; the
+    // sources are left empty. Into an empty Counter their arenas are adopted, so no
+    // key is copied. Otherwise only the keys this Counter did not have yet are
+    // copied into its arena, once the parallel pass is done, and the sources'
+    // arenas are freed: a Counter merged into chunk after chunk grows with its
+    // vocabulary, not with the number of merges.
+    //
+    // Partitioned merge: the table is sized once up front, then thread t owns the
+    // slot range [C*t/T, C*(t+1)/T) and inserts exactly the keys whose home slot is
+    // in its range, probing only inside it. Homes come from the high hash bits in
+    // every table, so each source is read as one contiguous run per thread (plus
+    // the cluster that overhangs its end). A probe that would leave the range is
+    // parked and finished serially afterwards; with the table at most 70% full
+    // these spills are rare.
+    void absorb(std::vector<Counter>& srcs, int nthreads) {
+        size_t total = size_, max_cap = 0;
+        for (const Counter& c : srcs) { total += c.size_; max_cap = std::max(max_cap, c.slots_.size()); }
+        if (total == size_) { for (Counter& c : srcs) c.clear(); return; }
+        reserve(total);
+        if (slots_.size() < max_cap) rehash(max_cap);
+
+        const size_t C = slots_.size();
+        const int T = (int)std::max<size_t>(1, std::min<size_t>((size_t)std::max(1, nthreads), C));
+        const bool adopt = size_ == 0;
+        std::vector<std::vector<const Slot*>> spill((size_t)T);
+        std::vector<std::vector<size_t>> fresh((size_t)T); // new slots, keys still in a source
+        std::vector<size_t> added((size_t)T, 0);
+
+#pragma omp parallel for schedule(static, 1) num_threads(T)
+        for (int t = 0; t < T; ++t) {
+            const size_t lo = C * (size_t)t / (size_t)T, hi = C * (size_t)(t + 1) / (size_t)T;
+            for (const Counter& src : srcs) {
+                if (src.slots_.empty()) continue;
+                // Source homes covering target homes [lo, hi): the source table is no
+                // larger, so its home index is a prefix of ours.
+                const unsigned d = src.shift_ - shift_;
+                const size_t smask = src.slots_.size() - 1;
+                const size_t sbeg = lo >> d, send = ((hi - 1) >> d) + 1;
+                const size_t slim = sbeg + src.slots_.size(); // never visit a slot twice
+                for (size_t i = sbeg; i < send || (i < slim && src.slots_[i & smask].key); ++i) {
+                    const Slot& sl = src.slots_[i & smask];
+                    if (!sl.key) continue;
+                    const size_t h = home(sl.hash);
+                    if (h < lo || h >= hi) continue;
+                    if (!place_in_range(sl, h, hi, added[(size_t)t], adopt ? nullptr : &fresh[(size_t)t]))
+                        spill[(size_t)t].push_back(&sl);
+                }
+            }
+        }
+
+        for (size_t a : added) size_ += a;
+        for (auto& v : fresh)
+            for (size_t i : v) slots_[i].key = arena_.intern(slots_[i].key, (size_t)slots_[i].len);
+        for (auto& v : spill)
+            for (const Slot* sl : v) place(*sl, !adopt);
+        for (Counter& c : srcs) {
+            if (adopt) arena_.adopt(std::move(c.arena_));
+            c.clear();
+        }
+    }
+
+    // Visit every occupied slot.
+    template <class F> void for_each_slot(F&& f) const {
+        for (const Slot& sl : slots_) if (sl.key) f(sl);
+    }
+    // Visit every (word, count).
+    template <class F> void for_each(F&& f) const {
+        for (const Slot& sl : slots_) if (sl.key) f(sl.view(), sl.count);
+    }
+
+private:
+    // Grow at 70% load.
+    static constexpr size_t kMaxLoadNum = 7, kMaxLoadDen = 10;
+
+    size_t home(uint64_t h) const { return shift_ >= 64 ? 0 : (size_t)(h >> shift_); }
+
+    void grow() { rehash(slots_.empty() ? 16 : slots_.size() * 2); }
+
+    // key (already known to have the joined length) == w[0] ' ' w[1] ... w[k-1]
+    static bool equal_words(const char* key, const std::string_view* w, size_t k) {
+        for (size_t j = 0; j < k; ++j) {
+            if (j && *key++ != ' ') return false;
+            if (std::memcmp(key, w[j].data(), w[j].size()) != 0) return false;
+            key += w[j].size();
+        }
+        return true;
+    }
+
+    // Insert-or-add 'sl' probing from 'i' but never at or past 'end'. The key bytes
+    // are referenced, not copied: callers adopt the arena that owns them, or copy
+    // the keys of the slots listed in 'fresh'.
+    bool place_in_range(const Slot& sl, size_t i, size_t end, size_t& added, std::vector<size_t>* fresh) {
+        for (; i < end; ++i) {
+            Slot& d = slots_[i];
+            if (!d.key) {
+                d = sl;
+                ++added;
+                if (fresh) fresh->push_back(i);
+                return true;
+            }
+            if (d.hash == sl.hash && d.len == sl.len && std::memcmp(d.key, sl.key, sl.len) == 0) {
+                d.count += sl.count;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Unbounded variant of place_in_range (wraps around), for the serial spill pass.
+    void place(const Slot& sl, bool copy_key) {
+        if ((size_ + 1) * kMaxLoadDen > slots_.size() * kMaxLoadNum) grow();
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = home(sl.hash);; i = (i + 1) & mask) {
+            Slot& d = slots_[i];
+            if (!d.key) {
+                d = sl;
+                if (copy_key) d.key = arena_.intern(sl.key, (size_t)sl.len);
+                ++size_;
+                return;
+            }
+            if (d.hash == sl.hash && d.len == sl.len && std::memcmp(d.key, sl.key, sl.len) == 0) {
+                d.count += sl.count;
+                return;
+            }
+        }
+    }
+
+    // cap must be a power of two. Keys stay where they are in the arena.
+    void rehash(size_t cap) {
+        std::vector<Slot> old;
+        old.swap(slots_);
+        slots_.assign(cap, Slot{});
+        shift_ = 64;
+        for (size_t c = cap; c > 1; c >>= 1) --shift_;
+        const size_t mask = cap - 1;
+        for (const Slot& sl : old) {
+            if (!sl.key) continue;
+            size_t i = home(sl.hash);
+            while (slots_[i].key) i = (i + 1) & mask;
+            slots_[i] = sl;
+        }
+    }
+
+    std::vector<Slot> slots_;
+    StringArena arena_;
+    size_t size_ = 0;
+    unsigned shift_ = 64;
+};
@@ -0,0 +1,333 @@
+#pragma once
+#include "count.hpp"
+#include "corpus.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <vector>
+
+// ------------ persistent count index (--index, build/mh_index) ------------
+// The reduced counts of every run so far, sorted by key, in one file that is used
+// straight from mmap:
+//
+//   IndexHeader | entries: n x {key offset, count}, in key order
+//               | by_count: n x entry number, count descending (ties in key order)
+//               | key bytes, concatenated in key order
+//               | meta: key settings and the sources counted so far (varints)
+//
+// Sections start 8-byte aligned. A key's length is the next entry's offset minus
+// its own. Point lookups binary-search the entries, prefix queries take the range
+// they share, top-N reads the head of by_count; none of them touches more pages
+// than it needs.
+//
+// Updating is a linear merge: the run's Counter is sorted once and merged with the
+// old entries into a new file, written to PATH.tmp and renamed over PATH. A source
+// (a regular input file, by canonical path, size and mtime) already recorded is
+// not counted again. A recorded file that has changed since is an error, because
+// its old counts cannot be taken back out; stdin is never recorded.
+
+constexpr uint32_t kIndexVersion = 1;
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t keys;          // entries
+    uint64_t total;         // sum of counts
+    uint64_t entries_off, by_count_off;
+    uint64_t key_bytes_off, key_bytes_len;
+    uint64_t meta_off, meta_len;
+};
+
+struct IndexEntry { uint64_t key_off, count; };
+
+struct IndexSource {
+    std::string path; // canonical
+    uint64_t size = 0;
+    uint64_t mtime_ns = 0;
+};
+
+// What the counts in an index mean: every update must count keys the same way.
+struct IndexMeta {
+    uint32_t tokenizer = TOK_ASCII;
+    uint32_t ngram = 1;
+    uint64_t stop_words = 0, stop_sig = 0; // stop-word set: size and xor of hashes
+    std::vector<IndexSource> sources;
+
+    static IndexMeta current() {
+        const CountOptions& o = count_options();
+        IndexMeta m;
+        m.tokenizer = (uint32_t)o.tokenizer;
+        m.ngram = (uint32_t)o.ngram;
+        m.stop_words = o.stopwords.size();
+        o.stopwords.for_each_slot([&](const Counter::Slot& sl) { m.stop_sig ^= sl.hash; });
+        return m;
+    }
+
+    bool same_keys(const IndexMeta& o) const {
+        return tokenizer == o.tokenizer && ngram == o.ngram && stop_words == o.stop_words && stop_sig == o.stop_sig;
+    }
+
+    std::string describe() const {
+        static const char* names[] = { "ascii", "utf8", "raw" };
+        return std::string("tokenizer ") + (tokenizer < 3 ? names[tokenizer] : "?") + ", ngram " +
+               std::to_string(ngram) + ", " + std::to_string(stop_words) + " stop words";
+    }
+
+    void encode(std::vector<char>& out) const {
+        put_varint(out, tokenizer);
+        put_varint(out, ngram);
+        put_varint(out, stop_words);
+        put_varint(out, stop_sig);
+        put_varint(out, sources.size());
+        for (auto& s : sources) {
+            put_varint(out, s.path.size());
+            out.insert(out.end(), s.path.begin(), s.path.end());
+            put_varint(out, s.size);
+            put_varint(out, s.mtime_ns);
+        }
+    }
+
+    void decode(const char* p, const char* e) {
+        tokenizer = (uint32_t)get_varint(p, e);
+        ngram = (uint32_t)get_varint(p, e);
+        stop_words = get_varint(p, e);
+        stop_sig = get_varint(p, e);
+        sources.resize(get_varint(p, e));
+        for (auto& s : sources) {
+            size_t len = get_varint(p, e);
+            if ((size_t)(e - p) < len) throw std::runtime_error("index meta truncated");
+            s.path.assign(p, len);
+            p += len;
+            s.size = get_varint(p, e);
+            s.mtime_ns = get_varint(p, e);
+        }
+    }
+};
+
+// Identity of a regular file as an index source; false if it cannot be stat'ed.
+inline bool stat_source(const std::string& path, IndexSource& s) {
+    struct stat st{};
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    std::error_code ec;
+    auto canon = std::filesystem::weakly_canonical(path, ec);
+    s.path = ec ? path : canon.string();
+    s.size = (uint64_t)st.st_size;
+    s.mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+    return true;
+}
+
+// Read-only view of an index file.
+class CountIndex {
+public:
+    explicit CountIndex(const std::string& path) : f_(path) {
+        const char* p = f_.data();
+        const size_t n = f_.size();
+        if (n < sizeof(IndexHeader)) throw std::runtime_error("Not a count index: " + path);
+        std::memcpy(&h_, p, sizeof h_);
+        if (std::memcmp(h_.magic, "MHIX", 4) != 0) throw std::runtime_error("Not a count index: " + path);
+        if (h_.version != kIndexVersion) throw std::runtime_error("Unsupported index version: " + path);
+        auto fits = [&](uint64_t off, uint64_t len) { return off <= n && len <= n - off; };
+        if (!fits(h_.entries_off, h_.keys * sizeof(IndexEntry)) || !fits(h_.by_count_off, h_.keys * 8) ||
+            !fits(h_.key_bytes_off, h_.key_bytes_len) || !fits(h_.meta_off, h_.meta_len))
+            throw std::runtime_error("Truncated count index: " + path);
+        entries_ = (const IndexEntry*)(p + h_.entries_off);
+        by_count_ = (const uint64_t*)(p + h_.by_count_off);
+        keys_ = p + h_.key_bytes_off;
+        meta_.decode(p + h_.meta_off, p + h_.meta_off + h_.meta_len);
+    }
+
+    size_t size() const { return (size_t)h_.keys; }
+    uint64_t total() const { return h_.total; }
+    const IndexMeta& meta() const { return meta_; }
+
+    std::string_view key(size_t i) const {
+        const uint64_t end = i + 1 < size() ? entries_[i + 1].key_off : h_.key_bytes_len;
+        return { keys_ + entries_[i].key_off, (size_t)(end - entries_[i].key_off) };
+    }
+    uint64_t count(size_t i) const { return entries_[i].count; }
+    // Entry number of the r-th most frequent key.
+    size_t by_count(size_t r) const { return (size_t)by_count_[r]; }
+
+    // First entry whose key is not less than k.
+    size_t lower_bound(std::string_view k) const {
+        size_t lo = 0, hi = size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (key(mid) < k) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    uint64_t get(std::string_view k) const {
+        size_t i = lower_bound(k);
+        return i < size() && key(i) == k ? count(i) : 0;
+    }
+
+    // Entries [first, last) whose keys start with p.
+    std::pair<size_t, size_t> prefix_range(std::string_view p) const {
+        size_t first = lower_bound(p), last = first;
+        while (last < size() && key(last).substr(0, p.size()) == p) ++last;
+        return { first, last };
+    }
+
+private:
+    MappedFile f_;
+    IndexHeader h_{};
+    const IndexEntry* entries_ = nullptr;
+    const uint64_t* by_count_ = nullptr;
+    const char* keys_ = nullptr;
+    IndexMeta meta_;
+};
+
+// Writes the merge of 'old' (may be null) and 'delta' to 'path' with 'meta'.
+inline void write_merged_index(const std::string& path, const CountIndex* old, const Counter& delta,
+                               const IndexMeta& meta) {
+    std::vector<const Counter::Slot*> d;
+    d.reserve(delta.size());
+    delta.for_each_slot([&](const Counter::Slot& sl) { d.push_back(&sl); });
+    std::sort(d.begin(), d.end(), [](auto* a, auto* b) { return a->view() < b->view(); });
+
+    std::vector<IndexEntry> entries;
+    std::vector<char> keys;
+    uint64_t total = 0;
+    auto emit = [&](std::string_view k, uint64_t c) {
+        entries.push_back({ keys.size(), c });
+        keys.insert(keys.end(), k.begin(), k.end());
+        total += c;
+    };
+    const size_t n_old = old ? old->size() : 0;
+    entries.reserve(n_old + d.size());
+    size_t i = 0, j = 0;
+    while (i < n_old || j < d.size()) {
+        if (j == d.size() || (i < n_old && old->key(i) < d[j]->view())) { emit(old->key(i), old->count(i)); ++i; }
+        else if (i == n_old || d[j]->view() < old->key(i)) { emit(d[j]->view(), d[j]->count); ++j; }
+        else { emit(old->key(i), old->count(i) + d[j]->count); ++i; ++j; }
+    }
+
+    std::vector<uint64_t> by_count(entries.size());
+    for (size_t r = 0; r < by_count.size(); ++r) by_count[r] = r;
+    std::stable_sort(by_count.begin(), by_count.end(),
+                     [&](uint64_t a, uint64_t b) { return entries[a].count > entries[b].count; });
+
+    std::vector<char> meta_bytes;
+    meta.encode(meta_bytes);
+
+    auto align8 = [](uint64_t x) { return (x + 7) & ~uint64_t(7); };
+    IndexHeader h{};
+    std::memcpy(h.magic, "MHIX", 4);
+    h.version = kIndexVersion;
+    h.keys = entries.size();
+    h.total = total;
+    h.entries_off = align8(sizeof(IndexHeader));
+    h.by_count_off = h.entries_off + entries.size() * sizeof(IndexEntry);
+    h.key_bytes_off = h.by_count_off + by_count.size() * 8;
+    h.key_bytes_len = keys.size();
+    h.meta_off = align8(h.key_bytes_off + keys.size());
+    h.meta_len = meta_bytes.size();
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        static const char zeros[8] = {};
+        f.write((const char*)&h, sizeof h);
+        f.write(zeros, (std::streamsize)(h.entries_off - sizeof h));
+        f.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(IndexEntry)));
+        f.write((const char*)by_count.data(), (std::streamsize)(by_count.size() * 8));
+        f.write(keys.data(), (std::streamsize)keys.size());
+        f.write(zeros, (std::streamsize)(h.meta_off - h.key_bytes_off - keys.size()));
+        f.write(meta_bytes.data(), (std::streamsize)meta_bytes.size());
+        if (!f) throw std::runtime_error("Failed to write index: " + tmp);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Failed to rename index to: " + path);
+}
+
+// Rank 0's side of --index for one run: main() opens it, the modes ask which inputs
+// are new and hand over the reduced counts at the end.
+class IndexRun {
+public:
+    bool on() const { return !path_.empty(); }
+
+    // Checks the key settings against an existing index. Throws on a mismatch.
+    void open(const std::string& path) {
+        path_ = path;
+        meta_ = IndexMeta::current();
+        if (!std::filesystem::exists(path)) return;
+        CountIndex idx(path);
+        if (!idx.meta().same_keys(meta_))
+            throw std::runtime_error("Index " + path + " counts keys differently (" + idx.meta().describe() +
+                                     ") from this run (" + meta_.describe() + ")");
+        known_ = idx.meta().sources;
+    }
+
+    // True if 'path' still needs counting; records it as a new source if so. Throws
+    // if the index has counted an earlier version of the file.
+    bool is_new(const std::string& path) {
+        IndexSource s;
+        if (!stat_source(path, s)) return true; // stdin, pipes: never recorded
+        for (auto& k : known_) {
+            if (k.path != s.path) continue;
+            if (k.size == s.size && k.mtime_ns == s.mtime_ns) return false;
+            throw std::runtime_error("Index " + path_ + " already counts an earlier version of " + s.path +
+                                     "; rebuild the index to count it again");
+        }
+        added_.push_back(s);
+        return true;
+    }
+
+    std::vector<InputFile> new_inputs(const std::vector<InputFile>& files) {
+        std::vector<InputFile> out;
+        for (auto& f : files) if (is_new(f.path)) out.push_back(f);
+        if (out.size() < files.size())
+            std::cerr << "[index] " << files.size() - out.size() << " of " << files.size()
+                      << " file(s) already in " << path_ << ", skipped\n";
+        return out;
+    }
+
+    // Merges this run's reduced counts into the index.
+    void commit(const Counter& delta) {
+        if (added_.empty() && delta.empty() && std::filesystem::exists(path_)) {
+            std::cerr << "[index] nothing new for " << path_ << "\n";
+            return;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        IndexMeta meta = meta_;
+        meta.sources = known_;
+        meta.sources.insert(meta.sources.end(), added_.begin(), added_.end());
+        size_t keys = 0;
+        uint64_t total = 0;
+        if (std::filesystem::exists(path_)) {
+            CountIndex old(path_);
+            write_merged_index(path_, &old, delta, meta);
+        } else {
+            write_merged_index(path_, nullptr, delta, meta);
+        }
+        {
+            CountIndex now(path_);
+            keys = now.size();
+            total = now.total();
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        std::cerr << "[index] merged " << delta.size() << " keys from " << added_.size() << " new source(s) into "
+                  << path_ << ": " << keys << " keys, " << total << " total, "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms\n";
+    }
+
+private:
+    std::string path_;
+    IndexMeta meta_;
+    std::vector<IndexSource> known_, added_;
+};
+
+inline IndexRun& index_run() {
+    static IndexRun r;
+    return r;
+}
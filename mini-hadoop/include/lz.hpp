@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// ------------ LZ block codec ------------
+// Small LZ77 codec in the LZ4 block layout (no external dependency, so the cluster
+// build stays a plain `make`). A block is a run of sequences:
+//
+//   token (hi nibble: literal length, lo nibble: match length - 4)
+//   [255 ... n] literal length extension, literals
+//   offset (2 bytes LE), [255 ... n] match length extension
+//
+// and the final sequence carries literals only. Matches reach back at most 64 KiB.
+
+namespace lz_detail {
+
+constexpr int kHashBits = 14;
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 65535;
+
+inline uint32_t read32(const char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+inline uint32_t hash4(uint32_t v) { return (v * 2654435761u) >> (32 - kHashBits); }
+
+inline void put_len(std::vector<char>& out, size_t n) {
+    while (n >= 255) { out.push_back((char)255); n -= 255; }
+    out.push_back((char)n);
+}
+
+inline void put_seq(std::vector<char>& out, const char* lit, size_t nlit, size_t off, size_t mlen) {
+    size_t m = mlen ? mlen - kMinMatch : 0;
+    out.push_back((char)(((nlit < 15 ? nlit : 15) << 4) | (m < 15 ? m : 15)));
+    if (nlit >= 15) put_len(out, nlit - 15);
+    out.insert(out.end(), lit, lit + nlit);
+    if (!mlen) return;
+    out.push_back((char)(off & 0xFF));
+    out.push_back((char)(off >> 8));
+    if (m >= 15) put_len(out, m - 15);
+}
+
+} // namespace lz_detail
+
+// Appends the compressed form of src[0..n) to out.
+inline void lz_compress(const char* src, size_t n, std::vector<char>& out) {
+    using namespace lz_detail;
+    std::vector<uint32_t> table((size_t)1 << kHashBits, 0); // position + 1, 0 = empty
+    size_t ip = 0, anchor = 0;
+    while (ip + kMinMatch <= n) {
+        uint32_t seq = read32(src + ip);
+        uint32_t& slot = table[hash4(seq)];
+        size_t ref = slot;
+        slot = (uint32_t)(ip + 1);
+        if (ref && ip - (ref - 1) <= kMaxOffset && read32(src + ref - 1) == seq) {
+            size_t r = ref - 1, len = kMinMatch;
+            while (ip + len < n && src[r + len] == src[ip + len]) ++len;
+            put_seq(out, src + anchor, ip - anchor, ip - r, len);
+            ip += len;
+            anchor = ip;
+        } else {
+            ++ip;
+        }
+    }
+    put_seq(out, src + anchor, n - anchor, 0, 0);
+}
+
+// Decompresses exactly 'raw' bytes into dst; throws on malformed input.
+inline void lz_decompress(const char* src, size_t n, char* dst, size_t raw) {
+    using namespace lz_detail;
+    const unsigned char* ip = (const unsigned char*)src;
+    const unsigned char* end = ip + n;
+    size_t op = 0;
+    auto bad = [] { throw std::runtime_error("lz: corrupt block"); };
+    auto get_len = [&](size_t base) {
+        size_t v = base;
+        if (base == 15) {
+            for (;;) {
+                if (ip >= end) bad();
+                unsigned char b = *ip++;
+                v += b;
+                if (b != 255) break;
+            }
+        }
+        return v;
+    };
+    while (ip < end) {
+        unsigned char tok = *ip++;
+        size_t nlit = get_len(tok >> 4);
+        if ((size_t)(end - ip) < nlit || raw - op < nlit) bad();
+        std::memcpy(dst + op, ip, nlit);
+        ip += nlit; op += nlit;
+        if (ip == end) break;
+        if (end - ip < 2) bad();
+        size_t off = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        size_t mlen = get_len(tok & 15) + kMinMatch;
+        if (off == 0 || off > op || raw - op < mlen) bad();
+        for (size_t i = 0; i < mlen; ++i, ++op) dst[op] = dst[op - off]; // may overlap
+    }
+    if (op != raw) bad();
+}
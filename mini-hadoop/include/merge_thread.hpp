@@ -0,0 +1,74 @@
+#pragma once
+#include "utils.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Background merger: serialized Counters handed over by the MPI thread are merged
+// into 'into' on a separate std::thread, so the loop that talks to MPI never stalls
+// on deserialization. It never calls MPI itself (MPI_THREAD_FUNNELED is enough).
+// A task pushed with push_task runs on the merge thread once every blob pushed
+// before it has been merged. This is how checkpoints see a consistent Counter.
+class MergeThread {
+public:
+    explicit MergeThread(Counter& into) : into_(into), th_([this] { run(); }) {}
+    MergeThread(const MergeThread&) = delete;
+    MergeThread& operator=(const MergeThread&) = delete;
+    ~MergeThread() { finish(); }
+
+    void push(std::vector<char> blob) {
+        if (blob.empty()) return;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            q_.push_back({ std::move(blob), {} });
+        }
+        cv_.notify_one();
+    }
+
+    void push_task(std::function<void(const Counter&)> task) {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            q_.push_back({ {}, std::move(task) });
+        }
+        cv_.notify_one();
+    }
+
+    // Merge everything queued so far, then stop. 'into' is complete afterwards.
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            if (closed_) return;
+            closed_ = true;
+        }
+        cv_.notify_one();
+        th_.join();
+    }
+
+private:
+    void run() {
+        for (;;) {
+            Item it;
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [&] { return closed_ || !q_.empty(); });
+                if (q_.empty()) return;
+                it = std::move(q_.front());
+                q_.pop_front();
+            }
+            if (it.task) it.task(into_);
+            else merge_serialized(into_, it.blob.data(), it.blob.size());
+        }
+    }
+
+    struct Item { std::vector<char> blob; std::function<void(const Counter&)> task; };
+
+    Counter& into_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Item> q_;
+    bool closed_ = false;
+    std::thread th_;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <mpi.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// ------------ node topology + MPI-3 shared memory ------------
+// Ranks that can share memory (same node) are grouped with
+// MPI_Comm_split_type(MPI_COMM_TYPE_SHARED). Local rank 0 of every node is its
+// leader; the leaders get their own communicator for inter-node traffic, ordered
+// by world rank so that world rank 0 is leader 0.
+
+struct NodeTopology {
+    MPI_Comm node = MPI_COMM_NULL;     // ranks on my node
+    MPI_Comm leaders = MPI_COMM_NULL;  // one rank per node (MPI_COMM_NULL on non-leaders)
+    int node_rank = 0, node_size = 1;
+    int n_nodes = 1, node_id = 0;      // node_id: my node's rank in 'leaders'
+
+    explicit NodeTopology(MPI_Comm world) {
+        int wrank = 0;
+        MPI_Comm_rank(world, &wrank);
+        MPI_Comm_split_type(world, MPI_COMM_TYPE_SHARED, wrank, MPI_INFO_NULL, &node);
+        MPI_Comm_rank(node, &node_rank);
+        MPI_Comm_size(node, &node_size);
+        MPI_Comm_split(world, node_rank == 0 ? 0 : MPI_UNDEFINED, wrank, &leaders);
+        if (leaders != MPI_COMM_NULL) {
+            MPI_Comm_rank(leaders, &node_id);
+            MPI_Comm_size(leaders, &n_nodes);
+        }
+        MPI_Bcast(&node_id, 1, MPI_INT, 0, node);
+        MPI_Bcast(&n_nodes, 1, MPI_INT, 0, node);
+    }
+    ~NodeTopology() {
+        if (leaders != MPI_COMM_NULL) MPI_Comm_free(&leaders);
+        if (node != MPI_COMM_NULL) MPI_Comm_free(&node);
+    }
+    NodeTopology(const NodeTopology&) = delete;
+    NodeTopology& operator=(const NodeTopology&) = delete;
+
+    bool leader() const { return node_rank == 0; }
+};
+
+// One MPI_Win_allocate_shared window over a node communicator: every rank owns a
+// segment of its own size and can read any peer's segment in place. Collective
+// (ctor, fence, dtor) over 'node'. Writes become visible to peers after fence();
+// the destructor fences too, so nobody frees memory a peer is still reading.
+class SharedSegment {
+public:
+    SharedSegment(size_t mine, MPI_Comm node) {
+        MPI_Win_allocate_shared((MPI_Aint)mine, 1, MPI_INFO_NULL, node, &base_, &win_);
+        MPI_Win_fence(0, win_);
+    }
+    ~SharedSegment() { MPI_Win_fence(0, win_); MPI_Win_free(&win_); }
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    char* data() { return (char*)base_; }
+
+    void fence() { MPI_Win_fence(0, win_); }
+
+    // Peer r's segment (directly addressable, no copy).
+    const char* peer(int r, size_t& n) const {
+        MPI_Aint sz = 0;
+        int disp = 1;
+        void* p = nullptr;
+        MPI_Win_shared_query(win_, r, &sz, &disp, &p);
+        n = (size_t)sz;
+        return (const char*)p;
+    }
+
+private:
+    void* base_ = nullptr;
+    MPI_Win win_ = MPI_WIN_NULL;
+};
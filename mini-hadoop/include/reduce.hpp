@@ -0,0 +1,146 @@
+#pragma once
+#include <mpi.h>
+
+#include "comm.hpp"
+#include "utils.hpp"
+#include <string>
+#include <vector>
+
+// ------------ cross-rank reduction of Counters ------------
+// Every strategy leaves rank 0's 'local' ready for topN (see reduce_counts) and
+// leaves other ranks' 'local' in an unspecified (possibly partially merged) state.
+
+constexpr int TAG_REDUCE = 901;
+
+// Gather-to-root: every rank ships its full Counter to rank 0, which deserializes
+// and merges the P-1 blobs one after another.
+inline void reduce_gather(Counter& local, MPI_Comm comm) {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    std::vector<char> blob;
+    if (rank != 0) serialize_counter(local, blob);
+
+    std::vector<size_t> sizes, disps;
+    std::vector<char> recvbuf;
+
+    // ------------------------------------------------------------------------
+    // MPI_Gather + MPI_Gatherv
+    // ------------------------------------------------------------------------
+    // Collect the serialized word count results (see gatherv_bytes in comm.hpp).
+    //
+    // - Each rank first sends its blob size as a 64-bit value; rank 0 collects
+    //   them into 'sizes' and computes exact displacements 'disps'.
+    // - Each worker then sends its 'blob' (serialized Counter), and rank 0
+    //   receives the variable-sized blobs contiguously into 'recvbuf'.
+    //
+    // After this, rank 0 holds *all* partial word count results in 'recvbuf',
+    // ready to be deserialized and merged.
+    {
+        PhaseTimer timer(PH_COMM);
+        gatherv_bytes(blob.data(), blob.size(), recvbuf, sizes, disps, 0, comm);
+    }
+
+    if (rank == 0) {
+        for (int r = 1; r < size; ++r) {
+            if (sizes[r] == 0) continue;
+            merge_serialized(local, recvbuf.data() + disps[r], sizes[r]);
+        }
+    }
+}
+
+// Send / receive one serialized Counter (64-bit size header, then the blob).
+inline void send_counter(const Counter& c, int dest, int tag, MPI_Comm comm) {
+    std::vector<char> blob;
+    serialize_counter(c, blob);
+    PhaseTimer timer(PH_COMM);
+    uint64_t n = blob.size();
+    MPI_Send(&n, 1, MPI_UINT64_T, dest, tag, comm);
+    send_bytes(blob.data(), blob.size(), dest, tag, comm);
+}
+
+inline void recv_merge_counter(Counter& dst, int src, int tag, MPI_Comm comm) {
+    uint64_t n = 0;
+    std::vector<char> blob;
+    {
+        PhaseTimer timer(PH_COMM);
+        MPI_Recv(&n, 1, MPI_UINT64_T, src, tag, comm, MPI_STATUS_IGNORE);
+        blob.resize(n);
+        recv_bytes(blob.data(), n, src, tag, comm);
+    }
+    if (n) merge_serialized(dst, blob.data(), blob.size());
+}
+
+// Binomial tree: in round k, every rank with bit k set sends its (already merged)
+// Counter to rank - 2^k and drops out; the receiver merges it. After ceil(log2 P)
+// rounds rank 0 holds everything. Merge work and traffic into any single rank are
+// O(log P) blobs instead of P-1, and the rounds run in parallel across the tree.
+inline void reduce_tree(Counter& local, MPI_Comm comm) {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    for (int mask = 1; mask < size; mask <<= 1) {
+        if (rank & mask) {
+            send_counter(local, rank - mask, TAG_REDUCE, comm);
+            return;
+        }
+        if (rank + mask < size) recv_merge_counter(local, rank + mask, TAG_REDUCE, comm);
+    }
+}
+
+// MapReduce-style shuffle: each rank hash-partitions its counts by key_owner and
+// exchanges the partitions with one MPI_Alltoallv. On return every rank holds the
+// exact global counts for a disjoint 1/P slice of the vocabulary, so no rank ever
+// needs memory for the whole vocabulary.
+inline Counter shuffle_by_key(const Counter& local, MPI_Comm comm) {
+    int size = 1;
+    MPI_Comm_size(comm, &size);
+
+    std::vector<std::vector<char>> out, in;
+    serialize_partitioned(local, size, out);
+    {
+        PhaseTimer timer(PH_COMM);
+        alltoallv_bytes(out, in, comm);
+    }
+    out.clear();
+
+    Counter shard;
+    for (auto& blob : in)
+        if (!blob.empty()) merge_serialized(shard, blob.data(), blob.size());
+    return shard;
+}
+
+// Distributed top-k over a sharded vocabulary. Shards are disjoint, so the global
+// top N is contained in the union of every shard's local top N: only those P*N
+// candidates are gathered, and rank 0's 'shard' is replaced by them.
+inline void gather_top_candidates(Counter& shard, int N, MPI_Comm comm) {
+    Counter cand;
+    for (auto& kv : topN(shard, N)) cand.add(kv.first, kv.second);
+    shard = std::move(cand);
+    reduce_gather(shard, comm);
+}
+
+// Last step of a shuffle, once every rank holds its complete shard: the top-N
+// candidates go to rank 0, or with N < 0 (--index) the shards are gathered whole.
+inline void reduce_shards(Counter& shard, int N, MPI_Comm comm) {
+    if (N < 0) reduce_gather(shard, comm);
+    else gather_top_candidates(shard, N, comm);
+}
+
+// Dispatch on --reduce. For gather/tree rank 0 ends up with the full global Counter;
+// for shuffle it ends up with the top-N candidates only, which is all topN needs,
+// unless N < 0 (--index): then the disjoint shards are gathered whole.
+inline void reduce_counts(Counter& local, const std::string& how, int N, MPI_Comm comm) {
+    if (how == "tree") {
+        reduce_tree(local, comm);
+    } else if (how == "shuffle") {
+        Counter shard = shuffle_by_key(local, comm);
+        local = std::move(shard);
+        reduce_shards(local, N, comm);
+    } else {
+        reduce_gather(local, comm);
+    }
+    stats().note_table(local.size());
+}
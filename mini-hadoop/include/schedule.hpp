@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+// ------------ dynamic-mode chunk scheduling ------------
+// The master cuts chunks on demand, as workers ask for them, so a policy can size
+// each chunk from what it knows *now* (bytes left, who is asking, how fast they
+// have been) instead of fixing every boundary before the first send.
+//
+//   lines    : --chunk-lines M lines per chunk (the original behaviour)
+//   bytes    : ~--chunk-bytes B bytes per chunk, whatever the line lengths
+//   guided   : remaining / (2 * workers * prefetch), never below B; big chunks
+//              first, geometrically smaller towards the end to trim the tail
+//   adaptive : like guided, but each worker's share of the remaining bytes is
+//              proportional to its measured throughput (share of bytes_completed),
+//              so a slow or noisy node is handed less and finishes with the rest
+//
+// Byte-sized chunks end at the next whitespace, so no token is ever split.
+
+struct Chunk { int id; size_t a, b; size_t bytes() const { return b - a; } };
+
+class ChunkScheduler {
+public:
+    // 'bytes_completed' is the master's per-rank progress vector; adaptive reads it.
+    ChunkScheduler(const std::vector<char>& buf, const std::string& policy,
+                   int chunk_lines, size_t chunk_bytes, int workers, int prefetch,
+                   const std::vector<size_t>& bytes_completed)
+        : buf_(buf), policy_(policy), chunk_lines_(std::max(1, chunk_lines)),
+          chunk_bytes_(std::max<size_t>(1, chunk_bytes)), workers_(std::max(1, workers)),
+          prefetch_(std::max(1, prefetch)), done_(bytes_completed) {}
+
+    bool empty() const { return pos_ >= buf_.size(); }
+    size_t remaining() const { return buf_.size() - pos_; }
+    int issued() const { return issued_; }
+
+    // Cuts the next chunk for worker 'w'. Precondition: !empty().
+    Chunk next(int w) {
+        size_t a = pos_, b;
+        if (policy_ == "lines") b = after_lines(a, chunk_lines_);
+        else                    b = after_bytes(a, target_bytes(w));
+        pos_ = b;
+        return { issued_++, a, b };
+    }
+
+private:
+    size_t after_lines(size_t a, int lines) const {
+        const char* d = buf_.data();
+        size_t n = buf_.size();
+        for (int k = 0; k < lines && a < n; ++k) {
+            const void* nl = std::memchr(d + a, '\n', n - a);
+            a = nl ? (size_t)((const char*)nl - d) + 1 : n;
+        }
+        return a;
+    }
+
+    size_t after_bytes(size_t a, size_t want) const {
+        size_t n = buf_.size();
+        if (want >= n - a) return n;
+        return next_ws(buf_.data(), n, a + want);
+    }
+
+    size_t target_bytes(int w) const {
+        if (policy_ == "bytes") return chunk_bytes_;
+        size_t guided = remaining() / (2 * (size_t)workers_ * prefetch_);
+        if (policy_ == "adaptive") {
+            // Every worker has been busy since the start (prefetch keeps its queue
+            // full), so its share of bytes_completed is its share of the throughput.
+            // Workers with nothing back yet keep the guided size.
+            double total = 0;
+            for (size_t r = 1; r < done_.size(); ++r) total += (double)done_[r];
+            if (total > 0 && done_[w] > 0) {
+                double share = (double)done_[w] / total;
+                guided = (size_t)(share * (double)remaining() / (2.0 * prefetch_));
+            }
+        }
+        return std::max(guided, chunk_bytes_);
+    }
+
+    const std::vector<char>& buf_;
+    std::string policy_;
+    int chunk_lines_;
+    size_t chunk_bytes_;
+    int workers_, prefetch_;
+    const std::vector<size_t>& done_;
+    size_t pos_ = 0;
+    int issued_ = 0;
+};
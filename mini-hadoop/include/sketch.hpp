@@ -0,0 +1,321 @@
+#pragma once
+#include <mpi.h>
+
+#include "comm.hpp"
+#include "count.hpp"
+#include "reduce.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <omp.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// ------------ approximate heavy hitters (--approx K) ------------
+// Instead of an exact Counter over the whole vocabulary, every thread and rank keeps
+//
+//   SpaceSaving  K (key, count, err) entries. count overestimates the true count by
+//                at most err, and err <= N/K (N = tokens seen). Mergeable (Cafaro et
+//                al.): a key missing on one side is charged that side's minimum.
+//   CountMin     depth x width uint64 counters. Never underestimates; overestimates
+//                by more than e/width * N with probability at most e^-depth.
+//                Merged by element-wise sum (one fixed-size MPI_Reduce).
+//
+// so memory and traffic depend on K, width and depth only, not on the vocabulary.
+// Reported per word: estimate = min(SpaceSaving count, CountMin), and the interval
+// [count - err, estimate] that provably contains the true count.
+
+struct HeavyHitter {
+    std::string key;
+    uint64_t estimate, lower;
+};
+
+class SpaceSaving {
+public:
+    explicit SpaceSaving(size_t k = 1024) : k_(std::max<size_t>(1, k)) {
+        entries_.reserve(k_);
+        heap_.reserve(k_);
+        index_.reserve(k_ * 2);
+    }
+    // Entries point into their own key strings, so no copies or moves.
+    SpaceSaving(const SpaceSaving&) = delete;
+    SpaceSaving& operator=(const SpaceSaving&) = delete;
+
+    size_t capacity() const { return k_; }
+    size_t size() const { return entries_.size(); }
+    bool full() const { return entries_.size() == k_; }
+    uint64_t total() const { return n_; }
+    uint64_t min_count() const { return heap_.empty() ? 0 : entries_[heap_[0]].count; }
+
+    void add(std::string_view key, uint64_t w = 1) { add(key, w, 0); n_ += w; }
+
+    // Merge 'o' into this summary (the result keeps the K largest estimates).
+    void merge(const SpaceSaving& o) {
+        const uint64_t min_a = full() ? min_count() : 0, min_b = o.full() ? o.min_count() : 0;
+        std::vector<Entry> all;
+        all.reserve(entries_.size() + o.entries_.size());
+        for (const Entry& e : entries_) {
+            auto it = o.index_.find(e.key);
+            if (it != o.index_.end()) {
+                const Entry& b = o.entries_[it->second];
+                all.push_back({ e.key, e.count + b.count, e.err + b.err, 0 });
+            } else {
+                all.push_back({ e.key, e.count + min_b, e.err + min_b, 0 });
+            }
+        }
+        for (const Entry& b : o.entries_)
+            if (!index_.count(b.key)) all.push_back({ b.key, b.count + min_a, b.err + min_a, 0 });
+        if (all.size() > k_) {
+            std::nth_element(all.begin(), all.begin() + k_, all.end(),
+                             [](const Entry& x, const Entry& y) { return x.count > y.count; });
+            all.resize(k_);
+        }
+        const uint64_t n = n_ + o.n_;
+        rebuild(std::move(all));
+        n_ = n;
+    }
+
+    // Top N entries as (key, estimate, lower bound), largest first.
+    std::vector<HeavyHitter> top(size_t n) const {
+        std::vector<HeavyHitter> v;
+        for (const Entry& e : entries_) v.push_back({ e.key, e.count, e.count - e.err });
+        std::sort(v.begin(), v.end(), [](auto& x, auto& y) { return x.estimate > y.estimate; });
+        if (v.size() > n) v.resize(n);
+        return v;
+    }
+
+    void serialize(std::vector<char>& out) const {
+        out.clear();
+        put_varint(out, n_);
+        put_varint(out, entries_.size());
+        for (const Entry& e : entries_) {
+            put_varint(out, e.key.size());
+            out.insert(out.end(), e.key.begin(), e.key.end());
+            put_varint(out, e.count);
+            put_varint(out, e.err);
+        }
+    }
+
+    void deserialize(const char* p, size_t len) {
+        const char* e = p + len;
+        uint64_t n = get_varint(p, e);
+        std::vector<Entry> all(get_varint(p, e));
+        for (Entry& x : all) {
+            size_t kl = get_varint(p, e);
+            if ((size_t)(e - p) < kl) throw std::runtime_error("summary: truncated");
+            x.key.assign(p, kl);
+            p += kl;
+            x.count = get_varint(p, e);
+            x.err = get_varint(p, e);
+        }
+        rebuild(std::move(all));
+        n_ = n;
+    }
+
+private:
+    struct Entry { std::string key; uint64_t count, err; size_t pos; };
+    struct Hash { size_t operator()(std::string_view s) const { return hash_bytes(s.data(), s.size()); } };
+
+    void add(std::string_view key, uint64_t w, uint64_t err) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            entries_[it->second].count += w;
+            sift_down(entries_[it->second].pos);
+            return;
+        }
+        if (!full()) {
+            size_t i = entries_.size();
+            entries_.push_back({ std::string(key), w, err, heap_.size() });
+            heap_.push_back(i);
+            index_.emplace(entries_[i].key, i);
+            sift_up(heap_.size() - 1);
+            return;
+        }
+        // Evict the minimum: the newcomer inherits its count as error.
+        size_t i = heap_[0];
+        Entry& m = entries_[i];
+        index_.erase(m.key);
+        uint64_t floor = m.count;
+        m.key.assign(key.data(), key.size());
+        m.count = floor + w;
+        m.err = floor + err;
+        index_.emplace(m.key, i);
+        sift_down(0);
+    }
+
+    void rebuild(std::vector<Entry> all) {
+        index_.clear();
+        heap_.clear();
+        entries_.clear();
+        entries_.reserve(k_);
+        for (Entry& e : all) {
+            size_t i = entries_.size();
+            entries_.push_back({ std::move(e.key), e.count, e.err, i });
+            heap_.push_back(i);
+        }
+        for (size_t i = 0; i < entries_.size(); ++i) index_.emplace(entries_[i].key, i);
+        for (size_t i = heap_.size() / 2; i-- > 0;) sift_down(i);
+    }
+
+    // Min-heap on count over entry indices; Entry::pos tracks each entry's heap slot.
+    void swap_at(size_t a, size_t b) {
+        std::swap(heap_[a], heap_[b]);
+        entries_[heap_[a]].pos = a;
+        entries_[heap_[b]].pos = b;
+    }
+    uint64_t cnt(size_t h) const { return entries_[heap_[h]].count; }
+    void sift_up(size_t h) {
+        while (h && cnt((h - 1) / 2) > cnt(h)) { swap_at(h, (h - 1) / 2); h = (h - 1) / 2; }
+    }
+    void sift_down(size_t h) {
+        for (;;) {
+            size_t l = 2 * h + 1, r = l + 1, m = h;
+            if (l < heap_.size() && cnt(l) < cnt(m)) m = l;
+            if (r < heap_.size() && cnt(r) < cnt(m)) m = r;
+            if (m == h) return;
+            swap_at(h, m);
+            h = m;
+        }
+    }
+
+    size_t k_;
+    uint64_t n_ = 0;
+    std::vector<Entry> entries_;
+    std::vector<size_t> heap_;
+    std::unordered_map<std::string_view, size_t, Hash> index_;
+};
+
+class CountMin {
+public:
+    CountMin(size_t width = 1 << 16, size_t depth = 4)
+        : w_(std::max<size_t>(1, width)), d_(std::max<size_t>(1, depth)), t_(w_ * d_, 0) {}
+
+    size_t width() const { return w_; }
+    size_t depth() const { return d_; }
+
+    // Row i uses h1 + i*h2 (Kirsch-Mitzenmacher), both halves of one 64-bit hash.
+    void add(uint64_t h, uint64_t c = 1) {
+        const uint64_t h1 = h, h2 = (h >> 32) | 1;
+        for (size_t i = 0; i < d_; ++i) t_[i * w_ + (size_t)((h1 + i * h2) % w_)] += c;
+    }
+    uint64_t estimate(uint64_t h) const {
+        const uint64_t h1 = h, h2 = (h >> 32) | 1;
+        uint64_t m = UINT64_MAX;
+        for (size_t i = 0; i < d_; ++i) m = std::min(m, t_[i * w_ + (size_t)((h1 + i * h2) % w_)]);
+        return m;
+    }
+    void merge(const CountMin& o) { for (size_t i = 0; i < t_.size(); ++i) t_[i] += o.t_[i]; }
+
+    std::vector<uint64_t>& table() { return t_; }
+
+private:
+    size_t w_, d_;
+    std::vector<uint64_t> t_;
+};
+
+struct Summary {
+    SpaceSaving ss;
+    CountMin cms;
+    Summary(size_t k, size_t width, size_t depth) : ss(k), cms(width, depth) {}
+
+    void add(const char* s, size_t n) {
+        ss.add(std::string_view(s, n));
+        cms.add(hash_bytes(s, n));
+    }
+    void merge(const Summary& o) { ss.merge(o.ss); cms.merge(o.cms); }
+};
+
+// count_chunk_omp for summaries: same split rule, one Summary per thread, merged.
+inline void summarize_chunk_omp(const char* data, size_t n, int nthreads, Summary& out) {
+    if (n == 0) return;
+    if (nthreads <= 0) nthreads = 1;
+    PhaseTimer timer(PH_COUNT);
+    std::vector<std::unique_ptr<Summary>> locals((size_t)nthreads);
+#pragma omp parallel num_threads(nthreads)
+    {
+        ThreadBusyTimer busy;
+        int tid = omp_get_thread_num();
+        locals[(size_t)tid] = std::make_unique<Summary>(out.ss.capacity(), out.cms.width(), out.cms.depth());
+        Summary* mine = locals[(size_t)tid].get();
+        size_t start = split_point(data, n, tid, nthreads);
+        size_t end   = split_point(data, n, tid + 1, nthreads);
+        size_t tokens = 0;
+        if (start < end) tokenize(data + start, end - start, [&](const char* t, size_t len) { mine->add(t, len); ++tokens; });
+        stats().tokens += tokens;
+    }
+    for (auto& s : locals)
+        if (s) out.merge(*s);
+    stats().bytes_in += n;
+}
+
+// Reduce summaries to rank 0: CountMin tables with one MPI_Reduce(SUM), SpaceSaving
+// along a binomial tree (like reduce_tree). Every message is bounded by K entries.
+inline void reduce_summary(Summary& s, MPI_Comm comm) {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    auto& t = s.cms.table();
+    const size_t step = kMaxMsgBytes / sizeof(uint64_t);
+    {
+        PhaseTimer timer(PH_COMM);
+        for (size_t off = 0; off < t.size(); off += step) {
+            int n = (int)std::min(step, t.size() - off);
+            MPI_Reduce(rank == 0 ? MPI_IN_PLACE : t.data() + off, t.data() + off, n,
+                       MPI_UINT64_T, MPI_SUM, 0, comm);
+        }
+        if (rank != 0) stats().bytes_sent += t.size() * sizeof(uint64_t);
+    }
+
+    for (int mask = 1; mask < size; mask <<= 1) {
+        if (rank & mask) {
+            std::vector<char> blob;
+            s.ss.serialize(blob);
+            PhaseTimer timer(PH_COMM);
+            uint64_t n = blob.size();
+            MPI_Send(&n, 1, MPI_UINT64_T, rank - mask, TAG_REDUCE, comm);
+            send_bytes(blob.data(), blob.size(), rank - mask, TAG_REDUCE, comm);
+            return;
+        }
+        if (rank + mask < size) {
+            uint64_t n = 0;
+            std::vector<char> blob;
+            {
+                PhaseTimer timer(PH_COMM);
+                MPI_Recv(&n, 1, MPI_UINT64_T, rank + mask, TAG_REDUCE, comm, MPI_STATUS_IGNORE);
+                blob.resize(n);
+                recv_bytes(blob.data(), n, rank + mask, TAG_REDUCE, comm);
+            }
+            PhaseTimer timer(PH_MERGE);
+            SpaceSaving other(s.ss.capacity());
+            other.deserialize(blob.data(), blob.size());
+            s.ss.merge(other);
+        }
+    }
+}
+
+// Top N with both bounds applied (see the header comment).
+inline std::vector<HeavyHitter> approx_topN(const Summary& s, int N) {
+    auto v = s.ss.top(s.ss.capacity());
+    for (auto& h : v) h.estimate = std::min(h.estimate, s.cms.estimate(hash_bytes(h.key.data(), h.key.size())));
+    std::sort(v.begin(), v.end(), [](auto& x, auto& y) { return x.estimate > y.estimate; });
+    if ((int)v.size() > N) v.resize(N);
+    return v;
+}
+
+inline void print_approx_topN(const Summary& s, const std::vector<HeavyHitter>& v) {
+    size_t w = 0;
+    for (auto& h : v) w = std::max(w, h.key.size());
+    for (auto& h : v) {
+        std::cout.width((std::streamsize)w);
+        std::cout << std::left << h.key << "  ~" << h.estimate << "  [" << h.lower << ", " << h.estimate << "]\n";
+    }
+    const double n = (double)s.ss.total();
+    std::cout << "\nApproximate (K=" << s.ss.capacity() << ", CountMin " << s.cms.depth() << "x" << s.cms.width()
+              << "): " << s.ss.total() << " tokens; SpaceSaving error <= N/K = "
+              << (uint64_t)(n / (double)s.ss.capacity()) << ", CountMin error <= e*N/width = "
+              << (uint64_t)(std::exp(1.0) * n / (double)s.cms.width()) << " with prob >= "
+              << 1.0 - std::exp(-(double)s.cms.depth()) << "\n";
+}
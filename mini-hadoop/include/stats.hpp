@@ -0,0 +1,267 @@
+#pragma once
+#include <mpi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+// ------------ per-phase instrumentation (--stats, --trace) ------------
+// Every rank records the wall time it spends in each phase, bytes in and out,
+// tokens counted, its final hash-table size and its peak RSS. Each counting thread
+// also records its own busy time. At the end of the run the numbers are reduced
+// to min / avg / max over ranks (and over threads) and written as JSON by rank 0.
+// With --trace, every phase interval is also kept as a Chrome trace event
+// (chrome://tracing, ui.perfetto.dev), with one process per rank and one track
+// per thread.
+//
+// Phases are timed where the work happens (count_chunk_omp, serialize_counter,
+// merge_serialized, topN, the comm helpers' callers), so every mode is covered.
+// Phases never nest on one thread. Times are summed per rank over the threads
+// that ran them, so the merge thread's 'merge' can overlap the main thread's
+// other phases. When neither flag is given a timer costs one branch.
+
+constexpr int TAG_STATS = 902;
+
+enum Phase { PH_READ, PH_SCATTER, PH_WAIT, PH_COUNT, PH_SERIALIZE, PH_COMM, PH_MERGE, PH_TOPK, PH_N };
+
+inline const char* phase_name(int p) {
+    static const char* names[PH_N] = { "read", "scatter", "wait", "count", "serialize", "comm", "merge", "topk" };
+    return names[p];
+}
+
+class Stats {
+public:
+    static constexpr size_t kMaxTraceEvents = 1 << 20; // per rank; later events are dropped
+
+    bool on = false;    // --stats or --trace
+    bool trace = false; // --trace: keep every interval
+    std::atomic<uint64_t> bytes_in{0}, bytes_sent{0}, bytes_recv{0}, tokens{0};
+
+    // Sets the time origin; call on every rank right after a barrier. The calling
+    // thread becomes track 0.
+    void start() {
+        origin_ = std::chrono::steady_clock::now();
+        thread_id();
+    }
+
+    double now_us() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin_).count();
+    }
+
+    // Small sequential id per thread (the trace track), 0 for the thread that called start().
+    static int thread_id() {
+        static std::atomic<int> next{0};
+        thread_local int id = next++;
+        return id;
+    }
+
+    void add_phase(Phase p, double t0, double t1) {
+        std::lock_guard<std::mutex> lk(mu_);
+        phase_us_[p] += t1 - t0;
+        if (trace) push_event(p, t0, t1);
+    }
+
+    // One counting thread's busy interval (not a rank-level phase: the rank's
+    // 'count' already covers it).
+    void add_thread_busy(double t0, double t1) {
+        const int tid = thread_id();
+        std::lock_guard<std::mutex> lk(mu_);
+        if ((size_t)tid >= thread_us_.size()) thread_us_.resize((size_t)tid + 1, -1.0);
+        thread_us_[(size_t)tid] = std::max(0.0, thread_us_[(size_t)tid]) + (t1 - t0);
+        if (trace) push_event(PH_COUNT, t0, t1);
+    }
+
+    void note_table(size_t n) {
+        std::lock_guard<std::mutex> lk(mu_);
+        table_ = std::max<uint64_t>(table_, n);
+    }
+
+    // Rank 0 writes the reduced JSON to 'json_path' ("-" = stdout) and the merged
+    // trace to 'trace_path'; empty paths are skipped. Collective over 'comm'.
+    void report(const std::string& mode, const std::string& json_path, const std::string& trace_path, MPI_Comm comm);
+
+private:
+    void push_event(Phase p, double t0, double t1) {
+        if (events_.size() < kMaxTraceEvents) events_.push_back({ p, thread_id(), t0, t1 - t0 });
+        else ++dropped_;
+    }
+
+    struct Event { int phase, tid; double ts, dur; };
+
+    std::chrono::steady_clock::time_point origin_ = std::chrono::steady_clock::now();
+    std::mutex mu_;
+    double phase_us_[PH_N] = {};
+    std::vector<double> thread_us_; // -1: thread never counted
+    uint64_t table_ = 0;
+    std::vector<Event> events_;
+    uint64_t dropped_ = 0;
+};
+
+inline Stats& stats() {
+    static Stats s;
+    return s;
+}
+
+// Times the enclosing scope as phase 'p' on the current thread.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase p) : p_(p), t0_(stats().on ? stats().now_us() : -1) {}
+    ~PhaseTimer() { if (t0_ >= 0) stats().add_phase(p_, t0_, stats().now_us()); }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    Phase p_;
+    double t0_;
+};
+
+// Times one counting thread's share of a chunk.
+class ThreadBusyTimer {
+public:
+    ThreadBusyTimer() : t0_(stats().on ? stats().now_us() : -1) {}
+    ~ThreadBusyTimer() { if (t0_ >= 0) stats().add_thread_busy(t0_, stats().now_us()); }
+    ThreadBusyTimer(const ThreadBusyTimer&) = delete;
+    ThreadBusyTimer& operator=(const ThreadBusyTimer&) = delete;
+
+private:
+    double t0_;
+};
+
+inline long peak_rss_kb() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss; // KiB on Linux
+}
+
+inline void Stats::report(const std::string& mode, const std::string& json_path,
+                          const std::string& trace_path, MPI_Comm comm) {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // One fixed-layout row per rank: phases (ms), then the scalar metrics, then
+    // this rank's thread busy min / sum / max (ms) and how many threads counted.
+    static const char* metric_names[] = { "wall_ms", "bytes_in", "bytes_sent", "bytes_recv",
+                                          "tokens", "table_size", "peak_rss_kb" };
+    constexpr int M = 7, W = PH_N + M + 4;
+    std::vector<double> row(W, 0.0);
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        for (int p = 0; p < PH_N; ++p) row[p] = phase_us_[p] / 1000.0;
+        double tmin = 0, tsum = 0, tmax = 0, tn = 0;
+        for (double us : thread_us_) {
+            if (us < 0) continue;
+            tmin = tn ? std::min(tmin, us) : us;
+            tmax = std::max(tmax, us);
+            tsum += us;
+            ++tn;
+        }
+        row[PH_N + 0] = now_us() / 1000.0;
+        row[PH_N + 1] = (double)bytes_in;
+        row[PH_N + 2] = (double)bytes_sent;
+        row[PH_N + 3] = (double)bytes_recv;
+        row[PH_N + 4] = (double)tokens;
+        row[PH_N + 5] = (double)table_;
+        row[PH_N + 6] = (double)peak_rss_kb();
+        row[PH_N + M + 0] = tmin / 1000.0;
+        row[PH_N + M + 1] = tsum / 1000.0;
+        row[PH_N + M + 2] = tmax / 1000.0;
+        row[PH_N + M + 3] = tn;
+    }
+    std::vector<double> all(rank == 0 ? (size_t)W * size : 0);
+    MPI_Gather(row.data(), W, MPI_DOUBLE, all.data(), W, MPI_DOUBLE, 0, comm);
+
+    if (!trace_path.empty()) {
+        // Each rank renders its own events; rank 0 concatenates them.
+        std::ostringstream os;
+        os.precision(3);
+        os << std::fixed;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+               << ",\"args\":{\"name\":\"rank " << rank << "\"}},\n";
+            for (const Event& e : events_)
+                os << "{\"name\":\"" << phase_name(e.phase) << "\",\"ph\":\"X\",\"pid\":" << rank
+                   << ",\"tid\":" << e.tid << ",\"ts\":" << e.ts << ",\"dur\":" << e.dur << "},\n";
+            if (dropped_ && rank == 0)
+                std::cerr << "[stats] trace: " << dropped_ << " events dropped on rank 0\n";
+        }
+        // Rank 0 streams every rank's events straight into the file, one rank at a
+        // time (at most kMaxTraceEvents each, well under an int-counted message).
+        std::string mine = os.str();
+        if (rank != 0) {
+            uint64_t n = mine.size();
+            MPI_Send(&n, 1, MPI_UINT64_T, 0, TAG_STATS, comm);
+            MPI_Send(mine.data(), (int)n, MPI_CHAR, 0, TAG_STATS, comm);
+        } else {
+            std::ofstream f(trace_path, std::ios::binary);
+            if (!f) std::cerr << "[stats] cannot write " << trace_path << "\n";
+            f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" << mine;
+            std::vector<char> buf;
+            for (int r = 1; r < size; ++r) {
+                uint64_t n = 0;
+                MPI_Recv(&n, 1, MPI_UINT64_T, r, TAG_STATS, comm, MPI_STATUS_IGNORE);
+                buf.resize(n);
+                MPI_Recv(buf.data(), (int)n, MPI_CHAR, r, TAG_STATS, comm, MPI_STATUS_IGNORE);
+                f.write(buf.data(), (std::streamsize)n);
+            }
+            f << "{}]}\n";
+        }
+    }
+
+    if (rank != 0 || json_path.empty()) return;
+
+    auto at = [&](int r, int k) { return all[(size_t)r * W + k]; };
+    std::ostringstream js;
+    js.precision(6);
+    auto agg = [&](int k) {
+        double mn = at(0, k), mx = at(0, k), sum = 0;
+        for (int r = 0; r < size; ++r) { mn = std::min(mn, at(r, k)); mx = std::max(mx, at(r, k)); sum += at(r, k); }
+        js << "{\"min\": " << mn << ", \"avg\": " << sum / size << ", \"max\": " << mx << ", \"per_rank\": [";
+        for (int r = 0; r < size; ++r) js << (r ? ", " : "") << at(r, k);
+        js << "]}";
+    };
+
+    js << "{\n  \"mode\": \"" << mode << "\",\n  \"ranks\": " << size << ",\n  \"phases_ms\": {\n";
+    for (int p = 0; p < PH_N; ++p) {
+        js << "    \"" << phase_name(p) << "\": ";
+        agg(p);
+        js << (p + 1 < PH_N ? ",\n" : "\n");
+    }
+    js << "  },\n  \"metrics\": {\n";
+    for (int m = 0; m < M; ++m) {
+        js << "    \"" << metric_names[m] << "\": ";
+        agg(PH_N + m);
+        js << (m + 1 < M ? ",\n" : "\n");
+    }
+    // Counting threads across every rank: load imbalance inside and across ranks.
+    double tmin = 0, tsum = 0, tmax = 0, tn = 0;
+    for (int r = 0; r < size; ++r) {
+        double n = at(r, PH_N + M + 3);
+        if (!n) continue;
+        tmin = tn ? std::min(tmin, at(r, PH_N + M + 0)) : at(r, PH_N + M + 0);
+        tsum += at(r, PH_N + M + 1);
+        tmax = std::max(tmax, at(r, PH_N + M + 2));
+        tn += n;
+    }
+    const double tavg = tn ? tsum / tn : 0;
+    js << "  },\n  \"count_threads\": {\"threads\": " << tn << ", \"busy_ms_min\": " << tmin
+       << ", \"busy_ms_avg\": " << tavg << ", \"busy_ms_max\": " << tmax
+       << ", \"imbalance\": " << (tavg > 0 ? tmax / tavg : 0) << "}\n}\n";
+
+    if (json_path == "-") {
+        std::cout << js.str();
+        return;
+    }
+    std::ofstream f(json_path);
+    if (!f) std::cerr << "[stats] cannot write " << json_path << "\n";
+    else f << js.str();
+}
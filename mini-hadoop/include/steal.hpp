@@ -0,0 +1,118 @@
+#pragma once
+#include <mpi.h>
+
+#include <cstdint>
+#include <random>
+#include <thread>
+
+// ------------ dynamic-mode work stealing (--schedule steal) ------------
+// No dispatcher: the input is cut into C fixed chunks, every rank (rank 0 too)
+// starts with the contiguous range [C*r/P, C*(r+1)/P) and counts it front to
+// back. A rank whose range runs dry asks victims, in a random rotation, for work;
+// a victim hands over the upper half of what it has not started (its last chunk
+// too), or an empty range.
+//
+// Steal requests are point-to-point on a private communicator. A rank answers
+// them between chunks and while it waits for answers of its own, so two thieves
+// asking each other never deadlock. A rank gives up after a full rotation came
+// back empty and then keeps answering "empty" until every rank has given up
+// (MPI_Ibarrier). A range in flight from a victim to its thief can be missed by a
+// third rank's rotation, but the thief counts it, so nothing is lost; and since
+// nobody enters the barrier with a request unanswered, none is left behind.
+//
+// (One-sided cursors, MPI_Fetch_and_op to take and MPI_Compare_and_swap to
+// steal, would not need the victim's attention, but compare-and-swap crashes in
+// Open MPI 4.1's osc/rdma over shared memory, which is the default on one node.)
+
+class StealQueue {
+public:
+    // Collective over 'comm'.
+    StealQueue(uint64_t chunks, MPI_Comm comm) {
+        MPI_Comm_dup(comm, &comm_);
+        MPI_Comm_rank(comm_, &rank_);
+        MPI_Comm_size(comm_, &size_);
+        rng_.seed((unsigned)rank_ * 7919u + 1);
+        lo_ = chunks * (uint64_t)rank_ / (uint64_t)size_;
+        hi_ = chunks * (uint64_t)(rank_ + 1) / (uint64_t)size_;
+    }
+    ~StealQueue() { MPI_Comm_free(&comm_); }
+    StealQueue(const StealQueue&) = delete;
+    StealQueue& operator=(const StealQueue&) = delete;
+
+    // Next chunk of my own range, or -1 once it is empty. Answers pending
+    // requests first, so victims stay responsive at chunk granularity.
+    int64_t take() {
+        serve();
+        return lo_ < hi_ ? (int64_t)lo_++ : -1;
+    }
+
+    // Asks the other ranks in turn until one hands over a range. False once a
+    // full rotation came back empty.
+    bool steal() {
+        if (size_ < 2) return false;
+        const int start = (int)(rng_() % (unsigned)(size_ - 1));
+        for (int k = 0; k < size_ - 1; ++k) {
+            const int v = (rank_ + 1 + (start + k) % (size_ - 1)) % size_;
+            ++attempts_;
+            uint64_t got[2] = { 0, 0 };
+            MPI_Request reqs[2];
+            MPI_Irecv(got, 2, MPI_UINT64_T, v, TAG_GIVE, comm_, &reqs[1]);
+            MPI_Isend(nullptr, 0, MPI_BYTE, v, TAG_ASK, comm_, &reqs[0]);
+            wait_serving(2, reqs);
+            if (got[0] < got[1]) {
+                lo_ = got[0];
+                hi_ = got[1];
+                ++steals_;
+                stolen_ += hi_ - lo_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Call once take() and steal() have both come back empty. Collective: answers
+    // requests with empty ranges until every rank has called it.
+    void finish() {
+        MPI_Request bar;
+        MPI_Ibarrier(comm_, &bar);
+        wait_serving(1, &bar);
+    }
+
+    uint64_t steals() const { return steals_; }       // successful steals
+    uint64_t stolen() const { return stolen_; }       // chunks they brought in
+    uint64_t attempts() const { return attempts_; }   // victims asked
+
+private:
+    enum { TAG_ASK = 1, TAG_GIVE = 2 };
+
+    // Answers every request that has arrived with the upper half of my range.
+    void serve() {
+        for (;;) {
+            int flag = 0;
+            MPI_Status st;
+            MPI_Iprobe(MPI_ANY_SOURCE, TAG_ASK, comm_, &flag, &st);
+            if (!flag) return;
+            MPI_Recv(nullptr, 0, MPI_BYTE, st.MPI_SOURCE, TAG_ASK, comm_, MPI_STATUS_IGNORE);
+            const uint64_t mid = lo_ + (hi_ - lo_) / 2;
+            uint64_t give[2] = { mid, hi_ };
+            hi_ = mid;
+            MPI_Send(give, 2, MPI_UINT64_T, st.MPI_SOURCE, TAG_GIVE, comm_); // receive already posted
+        }
+    }
+
+    void wait_serving(int n, MPI_Request* reqs) {
+        for (;;) {
+            int done = 0;
+            MPI_Testall(n, reqs, &done, MPI_STATUSES_IGNORE);
+            if (done) return;
+            serve();
+            std::this_thread::yield();
+        }
+    }
+
+    MPI_Comm comm_ = MPI_COMM_NULL;
+    int rank_ = 0, size_ = 1;
+    uint64_t lo_ = 0, hi_ = 0;
+    std::mt19937 rng_;
+    uint64_t steals_ = 0, stolen_ = 0, attempts_ = 0;
+};
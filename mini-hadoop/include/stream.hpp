@@ -0,0 +1,173 @@
+#pragma once
+#include "utils.hpp"
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// ------------ streaming input (--stream) ------------
+// Reads a file, stdin ("-") or a pipe front to back in fixed-size windows and cuts
+// it into chunks as it goes, so nothing ever needs the whole corpus (or its size)
+// in memory. Whatever follows the last cut in a window (a partial line or token) is
+// carried over and completes with the next read.
+
+// How a chunk ends: after 'lines' newlines, or (lines == 0) at the first whitespace
+// at or after 'bytes'. A line-rule chunk that reaches 'max_line_bytes' without
+// enough newlines is cut at whitespace instead, so one huge line cannot make the
+// carry-over grow without bound.
+struct ChunkRule {
+    size_t lines = 0;
+    size_t bytes = 1 << 20;
+    size_t max_line_bytes = 64 << 20;
+};
+
+class WindowReader {
+public:
+    WindowReader(const std::string& path, size_t window) : window_(std::max<size_t>(window, 4096)) {
+        fd_ = path == "-" ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) throw std::runtime_error("Failed to open file: " + path);
+    }
+    ~WindowReader() { if (fd_ > STDIN_FILENO) ::close(fd_); }
+    WindowReader(const WindowReader&) = delete;
+    WindowReader& operator=(const WindowReader&) = delete;
+
+    // Next chunk into 'out'; false once the input is exhausted.
+    bool next(const ChunkRule& rule, std::vector<char>& out) {
+        for (;;) {
+            size_t cut = find_cut(rule);
+            if (!cut && eof_) cut = end_ - pos_;
+            if (cut) {
+                out.assign(buf_.data() + pos_, buf_.data() + pos_ + cut);
+                pos_ += cut;
+                return true;
+            }
+            if (eof_) return false;
+            fill();
+        }
+    }
+
+    size_t bytes_read() const { return total_; }
+
+private:
+    // Length of the next complete chunk in the buffer, 0 if more input is needed.
+    size_t find_cut(const ChunkRule& rule) const {
+        const char* d = buf_.data() + pos_;
+        const size_t avail = end_ - pos_;
+        if (rule.lines) {
+            size_t at = 0;
+            for (size_t k = 0; k < rule.lines; ++k) {
+                const void* nl = std::memchr(d + at, '\n', avail - at);
+                if (!nl) {
+                    if (avail < rule.max_line_bytes) return 0;
+                    break; // fall through to the byte rule
+                }
+                at = (size_t)((const char*)nl - d) + 1;
+                if (k + 1 == rule.lines) return at;
+            }
+        }
+        const size_t want = rule.lines ? rule.max_line_bytes : std::max<size_t>(1, rule.bytes);
+        if (avail <= want) return 0;
+        size_t ws = next_ws(d, avail, want);
+        return ws < avail ? ws : 0;
+    }
+
+    // Appends up to one window of input; sets eof_ when the input is done.
+    void fill() {
+        if (pos_) {
+            std::memmove(buf_.data(), buf_.data() + pos_, end_ - pos_);
+            end_ -= pos_;
+            pos_ = 0;
+        }
+        if (buf_.size() < end_ + window_) buf_.resize(end_ + window_);
+        ssize_t n;
+        do n = ::read(fd_, buf_.data() + end_, window_);
+        while (n < 0 && errno == EINTR);
+        if (n < 0) throw std::runtime_error(std::string("read failed: ") + std::strerror(errno));
+        if (n == 0) eof_ = true;
+        end_ += (size_t)n;
+        total_ += (size_t)n;
+    }
+
+    int fd_ = -1;
+    size_t window_;
+    std::vector<char> buf_;
+    size_t pos_ = 0, end_ = 0, total_ = 0;
+    bool eof_ = false;
+};
+
+// WindowReader on a background thread feeding a bounded queue of ready chunks, so
+// reading (or decompressing upstream of a pipe) overlaps with sending and counting.
+// The consumer side never calls MPI from the reader thread (MPI_THREAD_FUNNELED).
+class ChunkStream {
+public:
+    ChunkStream(const std::string& path, size_t window, ChunkRule rule, size_t depth)
+        : reader_(path, window), rule_(rule), depth_(std::max<size_t>(1, depth)),
+          th_([this] { run(); }) {}
+    ChunkStream(const ChunkStream&) = delete;
+    ChunkStream& operator=(const ChunkStream&) = delete;
+    ~ChunkStream() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+        th_.join();
+    }
+
+    // Blocks for the next chunk; false at end of input. Rethrows reader errors.
+    bool pop(std::vector<char>& out) {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [&] { return !q_.empty() || done_; });
+        if (q_.empty()) {
+            if (err_) std::rethrow_exception(err_);
+            return false;
+        }
+        out = std::move(q_.front());
+        q_.pop_front();
+        cv_.notify_all();
+        return true;
+    }
+
+    size_t bytes_read() const { return bytes_read_.load(std::memory_order_relaxed); }
+
+private:
+    void run() {
+        try {
+            std::vector<char> c;
+            while (reader_.next(rule_, c)) {
+                bytes_read_.store(reader_.bytes_read(), std::memory_order_relaxed);
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [&] { return q_.size() < depth_ || closed_; });
+                if (closed_) break;
+                q_.push_back(std::move(c));
+                cv_.notify_all();
+            }
+            bytes_read_.store(reader_.bytes_read(), std::memory_order_relaxed);
+        } catch (...) {
+            std::lock_guard<std::mutex> lk(mu_);
+            err_ = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lk(mu_);
+        done_ = true;
+        cv_.notify_all();
+    }
+
+    WindowReader reader_;
+    ChunkRule rule_;
+    size_t depth_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<std::vector<char>> q_;
+    bool closed_ = false, done_ = false;
+    std::exception_ptr err_;
+    std::atomic<size_t> bytes_read_{0};
+    std::thread th_;
+};
@@ -0,0 +1,383 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MH_X86 1
+#endif
+
+// ------------ byte classes ------------
+// Word chars are ASCII alnum plus the apostrophe, lowercased ASCII-only. This is
+// exactly what std::isalnum/std::tolower give in the "C" locale, which is the only
+// locale this program runs in (it never calls setlocale), minus the locale lookup.
+inline constexpr std::array<bool, 256> kWordChar = [] {
+    std::array<bool, 256> t{};
+    for (int c = '0'; c <= '9'; ++c) t[c] = true;
+    for (int c = 'a'; c <= 'z'; ++c) t[c] = true;
+    for (int c = 'A'; c <= 'Z'; ++c) t[c] = true;
+    t['\''] = true;
+    return t;
+}();
+
+inline constexpr std::array<char, 256> kLowerChar = [] {
+    std::array<char, 256> t{};
+    for (int c = 0; c < 256; ++c) t[c] = (char)((c >= 'A' && c <= 'Z') ? c + 32 : c);
+    return t;
+}();
+
+// ------------ classify kernels ------------
+// A kernel classifies one window of input: lowered[i] gets the lowercased byte and
+// bit i of 'bits' is set iff in[i] is a word char. Token boundaries are then found
+// on the bitmap with ctz (see tokenize_with), independent of the ISA used here.
+namespace tok_detail {
+
+constexpr size_t kWindow = 16 << 10;  // bytes classified per kernel call
+using ClassifyFn = void (*)(const char* in, size_t n, char* lowered, uint64_t* bits);
+
+inline void classify_tail(const char* in, size_t from, size_t n, char* lowered, uint64_t* bits) {
+    for (size_t i = from; i < n; ++i) {
+        unsigned char c = (unsigned char)in[i];
+        lowered[i] = kLowerChar[c];
+        if (kWordChar[c]) bits[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+}
+
+inline void classify_scalar(const char* in, size_t n, char* lowered, uint64_t* bits) {
+    std::memset(bits, 0, ((n + 63) / 64) * sizeof(uint64_t));
+    classify_tail(in, 0, n, lowered, bits);
+}
+
+#ifdef MH_X86
+// 16 bytes per step with range compares (SSE2 has no byte shuffle for a LUT).
+// Signed compares are fine: bytes >= 0x80 are negative and fail every range.
+__attribute__((target("sse2")))
+inline void classify_sse2(const char* in, size_t n, char* lowered, uint64_t* bits) {
+    std::memset(bits, 0, ((n + 63) / 64) * sizeof(uint64_t));
+    const __m128i c0 = _mm_set1_epi8('0' - 1), c9 = _mm_set1_epi8('9' + 1);
+    const __m128i ca = _mm_set1_epi8('a' - 1), cz = _mm_set1_epi8('z' + 1);
+    const __m128i cA = _mm_set1_epi8('A' - 1), cZ = _mm_set1_epi8('Z' + 1);
+    const __m128i apos = _mm_set1_epi8('\''), x20 = _mm_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (int k = 0; k < 4; ++k) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(in + i + 16 * k));
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, cA), _mm_cmpgt_epi8(cZ, v));
+            __m128i low = _mm_or_si128(v, _mm_and_si128(upper, x20));
+            __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(low, ca), _mm_cmpgt_epi8(cz, low));
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, c0), _mm_cmpgt_epi8(c9, v));
+            __m128i word_v = _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(v, apos));
+            _mm_storeu_si128((__m128i*)(lowered + i + 16 * k), low);
+            word |= (uint64_t)(uint16_t)_mm_movemask_epi8(word_v) << (16 * k);
+        }
+        bits[i >> 6] = word;
+    }
+    classify_tail(in, i, n, lowered, bits);
+}
+
+// 32 bytes per step. Word-char test is a nibble lookup: each high nibble selects a
+// class bit (apostrophe row, digit row, letter rows) and the low-nibble table says
+// which classes that column belongs to; a byte is a word char iff the two overlap.
+// Bytes >= 0x80 give high-nibble indices 8..15, which the table maps to 0.
+__attribute__((target("avx2")))
+inline void classify_avx2(const char* in, size_t n, char* lowered, uint64_t* bits) {
+    std::memset(bits, 0, ((n + 63) / 64) * sizeof(uint64_t));
+    //                        lo:  0     1     2     3     4     5     6     7     8     9     A     B     C     D     E     F
+    const __m256i lo_lut = _mm256_setr_epi8(
+        0x0A, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0F, 0x0E, 0x0E, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x0A, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0F, 0x0E, 0x0E, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x04);
+    //  hi: 2 -> apostrophe (bit0), 3 -> digits (bit1), 4/6 -> A-O/a-o (bit2), 5/7 -> P-Z/p-z (bit3)
+    const __m256i hi_lut = _mm256_setr_epi8(
+        0, 0, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i nib = _mm256_set1_epi8(0x0F), zero = _mm256_setzero_si256();
+    const __m256i cA = _mm256_set1_epi8('A' - 1), cZ = _mm256_set1_epi8('Z' + 1);
+    const __m256i x20 = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (int k = 0; k < 2; ++k) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(in + i + 32 * k));
+            __m256i lo = _mm256_and_si256(v, nib);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nib);
+            __m256i cls = _mm256_and_si256(_mm256_shuffle_epi8(lo_lut, lo), _mm256_shuffle_epi8(hi_lut, hi));
+            __m256i not_word = _mm256_cmpeq_epi8(cls, zero);
+            __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, cA), _mm256_cmpgt_epi8(cZ, v));
+            _mm256_storeu_si256((__m256i*)(lowered + i + 32 * k),
+                                _mm256_or_si256(v, _mm256_and_si256(upper, x20)));
+            word |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(not_word) << (32 * k);
+        }
+        bits[i >> 6] = word;
+    }
+    classify_tail(in, i, n, lowered, bits);
+}
+#endif
+
+struct Kernel { const char* name; ClassifyFn fn; };
+
+// Every kernel this CPU can run, narrowest first.
+inline std::vector<Kernel> available_kernels() {
+    std::vector<Kernel> ks{ { "scalar", classify_scalar } };
+#ifdef MH_X86
+    if (__builtin_cpu_supports("sse2")) ks.push_back({ "sse2", classify_sse2 });
+    if (__builtin_cpu_supports("avx2")) ks.push_back({ "avx2", classify_avx2 });
+#endif
+    return ks;
+}
+
+// Runtime dispatch: widest kernel available, resolved once.
+inline const Kernel& best_kernel() {
+    static const Kernel k = available_kernels().back();
+    return k;
+}
+
+inline size_t next_set(const uint64_t* bits, size_t from, size_t n) {
+    if (from >= n) return n;
+    size_t w = from >> 6;
+    uint64_t word = bits[w] & (~uint64_t(0) << (from & 63));
+    while (!word) {
+        if (++w * 64 >= n) return n;
+        word = bits[w];
+    }
+    return std::min(n, w * 64 + (size_t)__builtin_ctzll(word));
+}
+
+inline size_t next_clear(const uint64_t* bits, size_t from, size_t n) {
+    if (from >= n) return n;
+    size_t w = from >> 6;
+    uint64_t word = ~bits[w] & (~uint64_t(0) << (from & 63));
+    while (!word) {
+        if (++w * 64 >= n) return n;
+        word = ~bits[w];
+    }
+    return std::min(n, w * 64 + (size_t)__builtin_ctzll(word));
+}
+
+} // namespace tok_detail
+
+// ------------ tokenizers ------------
+// Both call sink(const char* lowered_token, size_t len) once per token, in order.
+// The pointer is only valid during the call.
+
+// Reference byte-at-a-time loop.
+template <class Sink>
+inline void tokenize_scalar(const char* data, size_t len, Sink&& sink) {
+    std::string tok; tok.reserve(64);
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)data[i];
+        if (kWordChar[c]) {
+            tok.push_back(kLowerChar[c]);
+        } else if (!tok.empty()) {
+            sink(tok.data(), tok.size()); tok.clear();
+        }
+    }
+    if (!tok.empty()) sink(tok.data(), tok.size());
+}
+
+// Windowed tokenizer on top of a classify kernel. A token that runs into the end
+// of a window is not emitted there; the next window starts at its first byte.
+template <class Sink>
+inline void tokenize_with(tok_detail::ClassifyFn classify, const char* data, size_t len, Sink&& sink) {
+    using namespace tok_detail;
+    alignas(64) char lowered[kWindow];
+    uint64_t bits[kWindow / 64];
+    std::string big;
+
+    size_t pos = 0;
+    while (pos < len) {
+        const size_t n = std::min(kWindow, len - pos);
+        const bool last = pos + n == len;
+        classify(data + pos, n, lowered, bits);
+
+        size_t i = 0, consumed = n;
+        for (;;) {
+            size_t s = next_set(bits, i, n);
+            if (s >= n) break;
+            size_t e = next_clear(bits, s, n);
+            if (e == n && !last) { consumed = s; break; }
+            sink(lowered + s, e - s);
+            i = e;
+        }
+
+        if (consumed == 0) {
+            // One token longer than a whole window: finish it byte by byte.
+            size_t e = pos;
+            big.clear();
+            while (e < len && kWordChar[(unsigned char)data[e]]) big.push_back(kLowerChar[(unsigned char)data[e++]]);
+            sink(big.data(), big.size());
+            consumed = e - pos;
+        }
+        pos += consumed;
+    }
+}
+
+template <class Sink>
+inline void tokenize(const char* data, size_t len, Sink&& sink) {
+    tokenize_with(tok_detail::best_kernel().fn, data, len, sink);
+}
+
+// ------------ UTF-8 tokenizer ------------
+// Words are runs of ASCII word chars (as above) and non-ASCII letters, with simple
+// Unicode case folding (CaseFolding.txt C+S) for Latin-1, Latin Extended-A and
+// Additional, Greek, Cyrillic, Armenian and fullwidth Latin; other scripts pass
+// through unchanged. U+2019 (right single quote) folds to the ASCII apostrophe, so
+// "don’t" and "don't" are one word. Non-ASCII punctuation, symbols and spaces
+// separate words. Malformed bytes are kept as they are, inside the word.
+namespace tok_detail {
+
+inline bool utf8_separator(uint32_t cp) {
+    if (cp < 0xC0) return cp != 0xAA && cp != 0xB5 && cp != 0xBA; // Latin-1 punctuation, NBSP
+    if (cp == 0x2019) return false; // folds to '\''
+    return cp == 0xD7 || cp == 0xF7 ||
+           (cp >= 0x2000 && cp <= 0x2BFF) ||   // general punctuation .. misc symbols and arrows
+           (cp >= 0x2E00 && cp <= 0x2E7F) ||   // supplemental punctuation
+           (cp >= 0x3000 && cp <= 0x303F) ||   // CJK symbols and punctuation
+           (cp >= 0xFE30 && cp <= 0xFE4F) || cp == 0xFEFF ||
+           (cp >= 0xFF01 && cp <= 0xFF0F) || (cp >= 0xFF1A && cp <= 0xFF20) ||
+           (cp >= 0xFF3B && cp <= 0xFF40) || (cp >= 0xFF5B && cp <= 0xFF65) ||
+           (cp >= 0x1F000 && cp <= 0x1FAFF);   // emoji and pictographs
+}
+
+inline uint32_t utf8_fold(uint32_t cp) {
+    auto even_up = [](uint32_t c) { return c | 1; };       // pairs (upper even, lower odd)
+    auto odd_up = [](uint32_t c) { return (c & 1) ? c + 1 : c; }; // pairs (upper odd, lower even)
+    if (cp < 0x100) return (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) ? cp + 0x20 : cp;
+    if (cp < 0x180) {
+        if (cp <= 0x12F || (cp >= 0x132 && cp <= 0x137) || (cp >= 0x14A && cp <= 0x177)) return even_up(cp);
+        if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) return odd_up(cp);
+        if (cp == 0x178) return 0xFF;
+        if (cp == 0x17F) return 's';
+        return cp;
+    }
+    if (cp >= 0x386 && cp <= 0x3AB) {
+        if (cp >= 0x391 && cp != 0x3A2) return cp + 0x20;
+        if (cp == 0x386) return 0x3AC;
+        if (cp >= 0x388 && cp <= 0x38A) return cp + 0x25;
+        if (cp == 0x38C) return 0x3CC;
+        if (cp == 0x38E || cp == 0x38F) return cp + 0x3F;
+        return cp;
+    }
+    if (cp == 0x3C2) return 0x3C3;
+    if (cp >= 0x400 && cp <= 0x40F) return cp + 0x50;
+    if (cp >= 0x410 && cp <= 0x42F) return cp + 0x20;
+    if ((cp >= 0x460 && cp <= 0x481) || (cp >= 0x48A && cp <= 0x4BF)) return even_up(cp);
+    if (cp >= 0x531 && cp <= 0x556) return cp + 0x30;
+    if ((cp >= 0x1E00 && cp <= 0x1E95) || (cp >= 0x1EA0 && cp <= 0x1EFF)) return even_up(cp);
+    if (cp == 0x1E9E) return 0xDF;
+    if (cp == 0x2019) return '\'';
+    if (cp >= 0xFF21 && cp <= 0xFF3A) return cp + 0x20;
+    return cp;
+}
+
+inline void put_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) out.push_back((char)cp);
+    else if (cp < 0x800) { out.push_back((char)(0xC0 | cp >> 6)); out.push_back((char)(0x80 | (cp & 0x3F))); }
+    else if (cp < 0x10000) {
+        out.push_back((char)(0xE0 | cp >> 12));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char)(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back((char)(0xF0 | cp >> 18));
+        out.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Decodes one code point at d[i] (d[i] >= 0x80); returns its length, 0 if malformed.
+inline size_t decode_utf8(const unsigned char* d, size_t i, size_t n, uint32_t& cp) {
+    const unsigned char c = d[i];
+    size_t len;
+    if (c >= 0xC2 && c <= 0xDF) { len = 2; cp = c & 0x1F; }
+    else if (c >= 0xE0 && c <= 0xEF) { len = 3; cp = c & 0x0F; }
+    else if (c >= 0xF0 && c <= 0xF4) { len = 4; cp = c & 0x07; }
+    else return 0;
+    if (i + len > n) return 0;
+    for (size_t k = 1; k < len; ++k) {
+        if ((d[i + k] & 0xC0) != 0x80) return 0;
+        cp = (cp << 6) | (d[i + k] & 0x3F);
+    }
+    if ((len == 3 && cp < 0x800) || (len == 4 && (cp < 0x10000 || cp > 0x10FFFF)) || (cp >= 0xD800 && cp <= 0xDFFF))
+        return 0;
+    return len;
+}
+
+// First byte >= 0x80 in d[i..n), or n.
+inline size_t next_high(const char* d, size_t i, size_t n) {
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w; std::memcpy(&w, d + i, 8);
+        if (w & 0x8080808080808080ull) break;
+    }
+    while (i < n && !((unsigned char)d[i] & 0x80)) ++i;
+    return i;
+}
+
+} // namespace tok_detail
+
+// Pure-ASCII stretches go through the SIMD tokenizer; each stretch around non-ASCII
+// bytes is decoded byte by byte, from the start of the word that holds the first
+// such byte to the first ASCII separator 64 bytes past the last one.
+template <class Sink>
+inline void tokenize_utf8(const char* data, size_t len, Sink&& sink) {
+    using namespace tok_detail;
+    const unsigned char* d = (const unsigned char*)data;
+    std::string tok; tok.reserve(64);
+    size_t pos = 0;
+    while (pos < len) {
+        const size_t hi = next_high(data, pos, len);
+        if (hi == len) { tokenize(data + pos, len - pos, sink); return; }
+        size_t i = hi;
+        while (i > pos && kWordChar[d[i - 1]]) --i;
+        if (i > pos) tokenize(data + pos, i - pos, sink); // ends on a separator: no word cut
+
+        size_t last_high = hi;
+        for (; i < len; ++i) {
+            const unsigned char c = d[i];
+            if (c < 0x80) {
+                if (kWordChar[c]) { tok.push_back(kLowerChar[c]); continue; }
+                if (!tok.empty()) { sink(tok.data(), tok.size()); tok.clear(); }
+                if (i >= last_high + 64) break;
+                continue;
+            }
+            last_high = i;
+            uint32_t cp;
+            const size_t n = decode_utf8(d, i, len, cp);
+            if (!n) { tok.push_back((char)c); continue; }
+            i += n - 1;
+            last_high = i;
+            if (utf8_separator(cp)) {
+                if (!tok.empty()) { sink(tok.data(), tok.size()); tok.clear(); }
+            } else {
+                put_utf8(tok, utf8_fold(cp));
+            }
+        }
+        if (!tok.empty()) { sink(tok.data(), tok.size()); tok.clear(); }
+        pos = i;
+    }
+}
+
+// ------------ raw-bytes tokenizer ------------
+// Words are maximal runs of non-whitespace bytes, exactly as they appear: no case
+// folding, punctuation kept. Tokens point into the input.
+inline constexpr std::array<bool, 256> kSpaceChar = [] {
+    std::array<bool, 256> t{};
+    for (char c : { ' ', '\t', '\n', '\v', '\f', '\r' }) t[(unsigned char)c] = true;
+    return t;
+}();
+
+template <class Sink>
+inline void tokenize_raw(const char* data, size_t len, Sink&& sink) {
+    size_t i = 0;
+    for (;;) {
+        while (i < len && kSpaceChar[(unsigned char)data[i]]) ++i;
+        if (i == len) return;
+        const size_t s = i;
+        while (i < len && !kSpaceChar[(unsigned char)data[i]]) ++i;
+        sink(data + s, i - s);
+    }
+}
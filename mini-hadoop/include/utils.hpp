@@ -2,15 +2,22 @@
 #include <algorithm>
 #include <cctype>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <iostream>
 
-using Counter = std::unordered_map<std::string, uint64_t>;
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "counter.hpp"  // Counter: interned open-addressing word -> count table
+#include "stats.hpp"
+#include "lz.hpp"
 
 // ------------ I/O ------------
 inline std::vector<char> slurp_file(const std::string& path) {
@@ -24,10 +31,66 @@ inline std::vector<char> slurp_file(const std::string& path) {
     return buf;
 }
 
+// Read-only mmap of a whole file. Mapping is lazy, so a rank that only scans
+// [a, b) only ever faults in (and reads from disk) the pages of that range.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Failed to open file: " + path);
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) { ::close(fd); throw std::runtime_error("Failed to stat file: " + path); }
+        n_ = (size_t)st.st_size;
+        if (n_) {
+            void* p = ::mmap(nullptr, n_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) { ::close(fd); throw std::runtime_error("Failed to mmap file: " + path); }
+            p_ = (const char*)p;
+        }
+        ::close(fd);
+    }
+    ~MappedFile() { if (p_) ::munmap((void*)p_, n_); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return p_; }
+    size_t size() const { return n_; }
+
+    // Hint that [a, b) is about to be streamed through once.
+    void advise_sequential(size_t a, size_t b) const {
+        if (!p_ || a >= b) return;
+        const size_t pg = (size_t)::sysconf(_SC_PAGESIZE);
+        size_t a0 = a - a % pg;
+        ::madvise((void*)(p_ + a0), b - a0, MADV_SEQUENTIAL);
+        ::madvise((void*)(p_ + a0), b - a0, MADV_WILLNEED);
+    }
+
+private:
+    const char* p_ = nullptr;
+    size_t n_ = 0;
+};
+
+// Process-wide cut rule, set once from the command line in main(). Keys of several
+// words (--ngram) run across spaces but never across a line break, so with them
+// every cut waits for a '\n'.
+struct CutOptions { bool lines = false; };
+inline CutOptions& cut_options() { static CutOptions c; return c; }
+
+// First whitespace at or after i (or n); a '\n' under cut_options().lines. Every
+// cut point in the tree goes through this, so ranks that compute their own cuts
+// agree with whitespace_cuts.
+inline size_t next_ws(const char* d, size_t n, size_t i) {
+    if (cut_options().lines) {
+        const void* nl = i < n ? std::memchr(d + i, '\n', n - i) : nullptr;
+        return nl ? (size_t)((const char*)nl - d) : n;
+    }
+    while (i < n && !std::isspace((unsigned char)d[i])) ++i;
+    return i;
+}
+
 // Split file [0..N) into 'size' contiguous ranges, then advance interior cut points
 // to the next whitespace to avoid splitting tokens.
 inline void whitespace_cuts(const std::vector<char>& buf, int size,
-                            std::vector<int>& sendcounts, std::vector<int>& displs) {
+                            std::vector<size_t>& sendcounts, std::vector<size_t>& displs) {
     const size_t N = buf.size();
     sendcounts.assign(size, 0);
     displs.assign(size, 0);
@@ -35,65 +98,161 @@ inline void whitespace_cuts(const std::vector<char>& buf, int size,
 
     std::vector<size_t> cuts(size + 1);
     for (int r = 0; r <= size; ++r) cuts[r] = (N * (size_t)r) / (size_t)size;
-
-    auto is_ws = [](char c){ return std::isspace((unsigned char)c); };
-    for (int r = 1; r < size; ++r) {
-        size_t i = cuts[r];
-        while (i < N && !is_ws(buf[i])) ++i;
-        cuts[r] = i;
-    }
+    for (int r = 1; r < size; ++r) cuts[r] = next_ws(buf.data(), N, cuts[r]);
     for (int r = 0; r < size; ++r) {
         size_t a = cuts[r], b = cuts[r + 1];
-        displs[r]    = (int)a;
-        sendcounts[r]= (int)(b - a);
+        displs[r]    = a;
+        sendcounts[r]= b - a;
     }
 }
 
 // ------------ serialization of Counter ------------
-inline void serialize_counter(const Counter& m, std::vector<char>& out) {
-    out.clear();
-    uint64_t sz = m.size();
-    out.insert(out.end(), (char*)&sz, (char*)&sz + sizeof(sz));
-    for (const auto& kv : m) {
-        uint64_t klen = kv.first.size();
-        out.insert(out.end(), (char*)&klen, (char*)&klen + sizeof(klen));
-        out.insert(out.end(), kv.first.data(), kv.first.data() + klen);
-        uint64_t c = kv.second;
-        out.insert(out.end(), (char*)&c, (char*)&c + sizeof(c));
+// Wire format v2 (every blob that crosses MPI: gathers, shuffles, TAG_DONE):
+//
+//   'M' 'H' <version=2> <flags>  varint(#entries)
+//   [flags & WIRE_LZ: varint(raw body bytes), then the body LZ-compressed (lz.hpp)]
+//   body: entries in key order, each front-coded against the previous key:
+//         varint(shared prefix) varint(suffix len) suffix varint(count)
+//
+// Typical words cost 3-6 bytes instead of the 16 bytes of fixed-width length and
+// count that v1 spent per entry.
+
+constexpr uint8_t kWireVersion = 2;
+enum : uint8_t { WIRE_LZ = 1 };
+
+// Process-wide wire settings, set once from the command line in main().
+struct WireOptions { bool compress = false; };
+inline WireOptions& wire_options() { static WireOptions w; return w; }
+
+inline void put_varint(std::vector<char>& out, uint64_t v) {
+    while (v >= 0x80) { out.push_back((char)(v | 0x80)); v >>= 7; }
+    out.push_back((char)v);
+}
+
+inline uint64_t get_varint(const char*& p, const char* e) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= e) throw std::runtime_error("deserialize truncated");
+        uint8_t b = (uint8_t)*p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
     }
+    throw std::runtime_error("deserialize: bad varint");
 }
 
-inline void deserialize_counter(const char* buf, size_t len, Counter& out) {
-    out.clear();
+// Sorts 'es' by key and writes one v2 blob to 'out'.
+inline void encode_entries(std::vector<const Counter::Slot*>& es, std::vector<char>& out, bool compress) {
+    std::sort(es.begin(), es.end(), [](auto* x, auto* y) { return x->view() < y->view(); });
+
+    std::vector<char> body;
+    std::vector<char>& dst = compress ? body : out;
+    out.assign({ 'M', 'H', (char)kWireVersion, (char)(compress ? WIRE_LZ : 0) });
+    put_varint(out, es.size());
+
+    std::string_view prev;
+    for (const Counter::Slot* sl : es) {
+        std::string_view k = sl->view();
+        size_t shared = 0, lim = std::min(prev.size(), k.size());
+        while (shared < lim && prev[shared] == k[shared]) ++shared;
+        put_varint(dst, shared);
+        put_varint(dst, k.size() - shared);
+        dst.insert(dst.end(), k.data() + shared, k.data() + k.size());
+        put_varint(dst, sl->count);
+        prev = k;
+    }
+
+    if (compress) {
+        put_varint(out, body.size());
+        lz_compress(body.data(), body.size(), out);
+    }
+}
+
+inline void serialize_counter(const Counter& m, std::vector<char>& out, bool compress) {
+    PhaseTimer timer(PH_SERIALIZE);
+    std::vector<const Counter::Slot*> es;
+    es.reserve(m.size());
+    m.for_each_slot([&](const Counter::Slot& sl) { es.push_back(&sl); });
+    encode_entries(es, out, compress);
+}
+
+inline void serialize_counter(const Counter& m, std::vector<char>& out) {
+    serialize_counter(m, out, wire_options().compress);
+}
+
+// Owner of a key when the vocabulary is sharded over 'parts' ranks. Uses the low
+// hash bits; Counter picks slots from the high ones, so shards still spread evenly.
+inline int key_owner(uint64_t hash, int parts) { return (int)(hash % (uint64_t)parts); }
+
+// One serialize_counter blob per owner: outs[r] holds exactly the keys r owns.
+inline void serialize_partitioned(const Counter& m, int parts, std::vector<std::vector<char>>& outs) {
+    PhaseTimer timer(PH_SERIALIZE);
+    std::vector<std::vector<const Counter::Slot*>> es(parts);
+    m.for_each_slot([&](const Counter::Slot& sl) { es[key_owner(sl.hash, parts)].push_back(&sl); });
+    outs.assign(parts, {});
+    for (int r = 0; r < parts; ++r) encode_entries(es[r], outs[r], wire_options().compress);
+}
+
+// Adds every entry of a serialized blob to 'dst' straight from the buffer: keys are
+// rebuilt in one reused string and looked up by (ptr, len), no temporary Counter.
+inline void merge_serialized(Counter& dst, const char* buf, size_t len) {
+    PhaseTimer timer(PH_MERGE);
     const char* p = buf;
     const char* e = buf + len;
-    auto need = [&](size_t n){ if ((size_t)(e - p) < n) throw std::runtime_error("deserialize truncated"); };
-    need(sizeof(uint64_t));
-    uint64_t sz = *(const uint64_t*)p; p += sizeof(uint64_t);
-    for (uint64_t i = 0; i < sz; ++i) {
-        need(sizeof(uint64_t));
-        uint64_t klen = *(const uint64_t*)p; p += sizeof(uint64_t);
-        need(klen + sizeof(uint64_t));
-        std::string key(p, p + klen); p += klen;
-        uint64_t c = *(const uint64_t*)p; p += sizeof(uint64_t);
-        out.emplace(std::move(key), c);
+    if (len < 4 || p[0] != 'M' || p[1] != 'H') throw std::runtime_error("deserialize: bad header");
+    if ((uint8_t)p[2] != kWireVersion) throw std::runtime_error("deserialize: unsupported wire version");
+    const uint8_t flags = (uint8_t)p[3];
+    p += 4;
+    const uint64_t n = get_varint(p, e);
+
+    std::vector<char> raw;
+    if (flags & WIRE_LZ) {
+        raw.resize(get_varint(p, e));
+        lz_decompress(p, (size_t)(e - p), raw.data(), raw.size());
+        p = raw.data();
+        e = raw.data() + raw.size();
     }
+
+    dst.reserve(dst.size() + n);
+    std::string key;
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t shared = get_varint(p, e);
+        uint64_t suffix = get_varint(p, e);
+        if (shared > key.size() || (uint64_t)(e - p) < suffix) throw std::runtime_error("deserialize truncated");
+        key.resize(shared);
+        key.append(p, suffix);
+        p += suffix;
+        dst.add(key.data(), key.size(), get_varint(p, e));
+    }
+    if (p != e) throw std::runtime_error("deserialize: trailing bytes");
+}
+
+inline void deserialize_counter(const char* buf, size_t len, Counter& out) {
+    out.clear();
+    merge_serialized(out, buf, len);
 }
 
 // ------------ merging & top-k ------------
+// Slots carry their hash, so merging never rehashes key bytes.
 inline void merge_into(Counter& dst, const Counter& src) {
-    for (const auto& kv : src) dst[kv.first] += kv.second;
+    src.for_each_slot([&](const Counter::Slot& sl) { dst.add_hashed(sl.hash, sl.key, sl.len, sl.count); });
 }
 
+// Selection runs over views into the table; only the N winners become strings.
 inline std::vector<std::pair<std::string, uint64_t>> topN(const Counter& c, int N) {
-    std::vector<std::pair<std::string, uint64_t>> v(c.begin(), c.end());
+    PhaseTimer timer(PH_TOPK);
+    std::vector<std::pair<std::string_view, uint64_t>> v;
+    v.reserve(c.size());
+    c.for_each([&](std::string_view k, uint64_t n) { v.emplace_back(k, n); });
     auto by_count = [](auto& a, auto& b){ return a.second > b.second; };
     if ((int)v.size() > N) {
         std::nth_element(v.begin(), v.begin() + N, v.end(), by_count);
         v.resize(N);
     }
     std::sort(v.begin(), v.end(), by_count);
-    return v;
+    std::vector<std::pair<std::string, uint64_t>> out;
+    out.reserve(v.size());
+    for (auto& kv : v) out.emplace_back(std::string(kv.first), kv.second);
+    return out;
 }
 
 inline void print_topN(const std::vector<std::pair<std::string, uint64_t>>& v) {
@@ -1,9 +1,18 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <cmath>
 
@@ -15,8 +24,8 @@ inline std::string ascii_bar(double frac, int width) {
     return s;
 }
 
-inline void print_static_bytes(const std::vector<int>& sendcounts, int barw) {
-    size_t totalB = 0; for (int b : sendcounts) totalB += (size_t)b;
+inline void print_static_bytes(const std::vector<size_t>& sendcounts, int barw) {
+    size_t totalB = 0; for (size_t b : sendcounts) totalB += b;
     std::cerr << "\n[static] per-rank bytes processed\n";
     for (size_t r = 0; r < sendcounts.size(); ++r) {
         double f = totalB ? (double)sendcounts[r] / (double)totalB : 0.0;
@@ -28,15 +37,16 @@ inline void print_static_bytes(const std::vector<int>& sendcounts, int barw) {
 inline void print_dynamic_progress(size_t total_bytes,
                                    const std::vector<size_t>& bytes_assigned,
                                    const std::vector<size_t>& bytes_completed,
-                                   int barw, int next_idx, int total_chunks) {
+                                   int barw, int issued_chunks,
+                                   std::ostream& os = std::cerr) {
     size_t done = std::accumulate(bytes_completed.begin(), bytes_completed.end(), (size_t)0);
     double frac_total = total_bytes ? (double)done / (double)total_bytes : 0.0;
-    std::cerr << "\n[dynamic] progress: " << (int)(frac_total * 100.0) << "%  "
-              << next_idx << "/" << total_chunks << " chunks\n";
+    os << "\n[dynamic] progress: " << (int)(frac_total * 100.0) << "%  "
+       << issued_chunks << " chunks issued\n";
     for (size_t r = 1; r < bytes_assigned.size(); ++r) {
         double f = bytes_assigned[r] ? (double)bytes_completed[r] / (double)bytes_assigned[r] : 0.0;
-        std::cerr << "Rank " << r << " [" << ascii_bar(f, barw) << "]  "
-                  << bytes_completed[r] << "/" << bytes_assigned[r] << "B\n";
+        os << "Rank " << r << " [" << ascii_bar(f, barw) << "]  "
+           << bytes_completed[r] << "/" << bytes_assigned[r] << "B\n";
     }
 }
 
@@ -49,3 +59,148 @@ inline void print_dynamic_assigned(const std::vector<size_t>& bytes_assigned, in
                   << bytes_assigned[r] << "B\n";
     }
 }
+
+// --schedule steal: what each rank counted, and how much of it it stole.
+inline void print_steal_summary(const std::vector<uint64_t>& per_rank, int barw) {
+    const size_t P = per_rank.size() / 3; // {bytes, chunks, chunks stolen} per rank
+    uint64_t tot = 0; for (size_t r = 0; r < P; ++r) tot += per_rank[3 * r];
+    std::cerr << "\n[dynamic] work stealing: per-rank bytes counted\n";
+    for (size_t r = 0; r < P; ++r) {
+        double f = tot ? (double)per_rank[3 * r] / (double)tot : 0.0;
+        std::cerr << "Rank " << r << " [" << ascii_bar(f, barw) << "]  " << per_rank[3 * r] << "B  "
+                  << per_rank[3 * r + 1] << " chunks (" << per_rank[3 * r + 2] << " stolen)\n";
+    }
+}
+
+// ------------ dynamic progress off the dispatch loop ------------
+// The master's loop only bumps relaxed atomics (one per event); a background thread
+// wakes every 'interval_ms', takes a snapshot and does all formatting and I/O, so a
+// slow terminal or file system never stalls dispatch. Its output is bounded: up to
+// kMaxBars workers get one bar each as before; beyond that one summary line shows
+// the spread of per-worker completion and the slowest few workers. With a status
+// file the snapshot is also written as JSON (to a temp file, then renamed, so a
+// viewer polling the path never sees a partial write). Never calls MPI.
+class ProgressReporter {
+public:
+    static constexpr int kMaxBars = 16;
+    static constexpr int kSlowest = 3;
+
+    ProgressReporter(int nranks, int interval_ms, int barw, std::string status_path)
+        : n_(nranks), interval_(interval_ms), barw_(barw), status_path_(std::move(status_path)),
+          assigned_(new std::atomic<size_t>[(size_t)nranks]), completed_(new std::atomic<size_t>[(size_t)nranks]),
+          t0_(std::chrono::steady_clock::now()) {
+        for (int r = 0; r < n_; ++r) { assigned_[r] = 0; completed_[r] = 0; }
+        if (interval_ > 0 || !status_path_.empty()) th_ = std::thread([this] { run(); });
+    }
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+    ~ProgressReporter() { stop(); }
+
+    void set_total(size_t b) { total_.store(b, std::memory_order_relaxed); }
+    void set_issued(int n) { issued_.store(n, std::memory_order_relaxed); }
+    void assigned(int w, size_t b) { assigned_[w].fetch_add(b, std::memory_order_relaxed); }
+    void completed(int w, size_t b) { completed_[w].fetch_add(b, std::memory_order_relaxed); }
+
+    // Joins the reporter; the status file is left with a final snapshot.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            if (stopped_) return;
+            stopped_ = true;
+        }
+        cv_.notify_all();
+        if (th_.joinable()) th_.join();
+    }
+
+private:
+    struct Snapshot {
+        size_t total = 0, done = 0;
+        int issued = 0;
+        double ms = 0;
+        std::vector<size_t> assigned, completed;
+    };
+
+    Snapshot snap() const {
+        Snapshot s;
+        s.total = total_.load(std::memory_order_relaxed);
+        s.issued = issued_.load(std::memory_order_relaxed);
+        s.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0_).count();
+        s.assigned.resize((size_t)n_);
+        s.completed.resize((size_t)n_);
+        for (int r = 0; r < n_; ++r) {
+            s.assigned[r] = assigned_[r].load(std::memory_order_relaxed);
+            s.completed[r] = completed_[r].load(std::memory_order_relaxed);
+            s.done += s.completed[r];
+        }
+        return s;
+    }
+
+    void run() {
+        const int tick = interval_ > 0 ? interval_ : 250;
+        size_t last_done = (size_t)-1;
+        for (;;) {
+            bool last;
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                last = cv_.wait_for(lk, std::chrono::milliseconds(tick), [&] { return stopped_; });
+            }
+            Snapshot s = snap();
+            if (!status_path_.empty()) write_status(s);
+            if (last) return;
+            if (interval_ > 0 && s.done != last_done) print(s);
+            last_done = s.done;
+        }
+    }
+
+    void print(const Snapshot& s) const {
+        std::ostringstream os;
+        if (n_ - 1 <= kMaxBars) {
+            // Few workers: the classic per-rank bars.
+            print_dynamic_progress(s.total, s.assigned, s.completed, barw_, s.issued, os);
+        } else {
+            std::vector<std::pair<double, int>> frac;
+            for (int r = 1; r < n_; ++r)
+                frac.emplace_back(s.assigned[r] ? (double)s.completed[r] / (double)s.assigned[r] : 0.0, r);
+            std::sort(frac.begin(), frac.end());
+            double avg = 0;
+            for (auto& f : frac) avg += f.first;
+            avg /= (double)frac.size();
+            os << "\n[dynamic] progress: " << pct(s.total ? (double)s.done / (double)s.total : 0.0) << "  "
+               << s.issued << " chunks issued  " << (int)mib_per_s(s) << " MiB/s  workers "
+               << pct(frac.front().first) << "/" << pct(avg) << "/" << pct(frac.back().first)
+               << " (min/avg/max)  slowest:";
+            for (int i = 0; i < kSlowest && i < (int)frac.size(); ++i)
+                os << " " << frac[(size_t)i].second << "@" << pct(frac[(size_t)i].first);
+            os << "\n";
+        }
+        std::cerr << os.str() << std::flush;
+    }
+
+    void write_status(const Snapshot& s) const {
+        const std::string tmp = status_path_ + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::trunc);
+            if (!f) return;
+            f << "{\"elapsed_ms\": " << s.ms << ", \"total_bytes\": " << s.total << ", \"done_bytes\": " << s.done
+              << ", \"chunks_issued\": " << s.issued << ", \"mib_per_s\": " << mib_per_s(s) << ", \"workers\": [";
+            for (int r = 1; r < n_; ++r)
+                f << (r > 1 ? ", " : "") << "[" << s.assigned[r] << ", " << s.completed[r] << "]";
+            f << "]}\n";
+        }
+        std::rename(tmp.c_str(), status_path_.c_str());
+    }
+
+    static std::string pct(double f) { return std::to_string((int)(f * 100.0)) + "%"; }
+    static double mib_per_s(const Snapshot& s) { return s.ms > 0 ? (double)s.done / (1 << 20) / (s.ms / 1000.0) : 0.0; }
+
+    const int n_, interval_, barw_;
+    const std::string status_path_;
+    std::unique_ptr<std::atomic<size_t>[]> assigned_, completed_;
+    std::atomic<size_t> total_{0};
+    std::atomic<int> issued_{0};
+    const std::chrono::steady_clock::time_point t0_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stopped_ = false;
+    std::thread th_;
+};
@@ -1,21 +1,21 @@
 #include <mpi.h>
 
+#include "args.hpp"
+#include "corpus.hpp"
 #include "count.hpp"
+#include "index.hpp"
+#include "stats.hpp"
 #include "utils.hpp"
 #include "viz.hpp"
 #include <omp.h>
+#include <algorithm>
 #include <chrono>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
 #include <iostream>
 #include <string>
 
-// shared arg struct (also used in other .cpp)
-struct Args {
-    std::string mode, path;
-    int topN = 20;
-    int chunk_lines = 400;
-    int bar_width = 50;
-};
-
 // Forward decls
 void run_static(const Args& a, int rank, int size);
 void run_dynamic(const Args& a, int rank, int size);
@@ -24,11 +24,28 @@ static void usage(int rank, const char* argv0) {
     if (rank == 0) {
         std::cerr
           << "Usage:\n"
-          << "  " << argv0 << " static  <corpus.txt> [--top N]\n"
-          << "  " << argv0 << " dynamic <corpus.txt> [--top N] [--chunk-lines M] [--bar-width W]\n";
+          << "  " << argv0 << " static  <corpus.txt> [--top N] [--ingest scatter|mmap] [--reduce gather|tree|shuffle]\n"
+          << "          [--node-aware] [--approx K [--cms-width W] [--cms-depth D]] [--pipeline [--block-bytes B]]\n"
+          << "  " << argv0 << " dynamic <corpus.txt> [--top N] [--chunk-lines M] [--bar-width W] [--prefetch K]\n"
+          << "          [--schedule lines|bytes|guided|adaptive|steal] [--chunk-bytes B]\n"
+          << "          [--progress-ms MS] [--status-file status.json]\n"
+          << "          [--checkpoint ckpt.bin [--checkpoint-ms MS] [--resume]] [--worker-timeout-ms MS]\n"
+          << "          [--accumulate [--flush-bytes B] [--reduce gather|tree|shuffle]]\n"
+          << "common: [--compress] [--stream [--window-bytes B]]   (<corpus.txt> may be '-' for stdin)\n"
+          << "        [--tokenizer ascii|utf8|raw] [--ngram N] [--stopwords words.txt]\n"
+          << "        [--stats out.json|-] [--trace trace.json] [--index counts.idx]\n"
+          << "<corpus.txt> may also be a directory, a quoted glob (\"data/*.txt\") or @manifest\n";
     }
 }
 
+// Falls back to the first (default) choice on unknown values.
+static void check_choice(int rank, const char* flag, std::string& v,
+                         std::initializer_list<const char*> choices) {
+    for (const char* c : choices) if (v == c) return;
+    if (rank == 0) std::cerr << "unknown " << flag << " '" << v << "', using " << *choices.begin() << "\n";
+    v = *choices.begin();
+}
+
 Args parse_args(int rank, int argc, char** argv) {
     Args a;
     if (argc >= 3) { a.mode = argv[1]; a.path = argv[2]; }
@@ -36,23 +53,166 @@ Args parse_args(int rank, int argc, char** argv) {
         std::string s = argv[i];
         if (s=="--top" && i+1<argc) a.topN = std::stoi(argv[++i]);
         else if (s=="--chunk-lines" && i+1<argc) a.chunk_lines = std::stoi(argv[++i]);
+        else if (s=="--schedule" && i+1<argc) a.schedule = argv[++i];
+        else if (s=="--chunk-bytes" && i+1<argc) a.chunk_bytes = std::stoull(argv[++i]);
         else if (s=="--bar-width" && i+1<argc) a.bar_width = std::stoi(argv[++i]);
+        else if (s=="--progress-ms" && i+1<argc) a.progress_ms = std::stoi(argv[++i]);
+        else if (s=="--status-file" && i+1<argc) a.status_file = argv[++i];
+        else if (s=="--checkpoint" && i+1<argc) a.checkpoint_path = argv[++i];
+        else if (s=="--checkpoint-ms" && i+1<argc) a.checkpoint_ms = std::stoi(argv[++i]);
+        else if (s=="--resume") a.resume = true;
+        else if (s=="--worker-timeout-ms" && i+1<argc) a.worker_timeout_ms = std::stoi(argv[++i]);
+        else if (s=="--prefetch" && i+1<argc) a.prefetch = std::stoi(argv[++i]);
+        else if (s=="--accumulate") a.accumulate = true;
+        else if (s=="--flush-bytes" && i+1<argc) a.flush_bytes = std::stoull(argv[++i]);
+        else if (s=="--ingest" && i+1<argc) a.ingest = argv[++i];
+        else if (s=="--reduce" && i+1<argc) a.reduce = argv[++i];
+        else if (s=="--node-aware") a.node_aware = true;
+        else if (s=="--approx" && i+1<argc) a.approx = std::stoull(argv[++i]);
+        else if (s=="--cms-width" && i+1<argc) a.cms_width = std::stoull(argv[++i]);
+        else if (s=="--cms-depth" && i+1<argc) a.cms_depth = std::stoull(argv[++i]);
+        else if (s=="--compress") a.compress = true;
+        else if (s=="--tokenizer" && i+1<argc) a.tokenizer = argv[++i];
+        else if (s=="--ngram" && i+1<argc) a.ngram = std::stoi(argv[++i]);
+        else if (s=="--stopwords" && i+1<argc) a.stopwords_path = argv[++i];
+        else if (s=="--stream") a.stream = true;
+        else if (s=="--pipeline") a.pipeline = true;
+        else if (s=="--block-bytes" && i+1<argc) a.block_bytes = std::stoull(argv[++i]);
+        else if (s=="--window-bytes" && i+1<argc) a.window_bytes = std::stoull(argv[++i]);
+        else if (s=="--index" && i+1<argc) a.index_path = argv[++i];
+        else if (s=="--stats" && i+1<argc) a.stats_path = argv[++i];
+        else if (s=="--trace" && i+1<argc) a.trace_path = argv[++i];
     }
+    if (a.path == "-") a.stream = true; // stdin can only be streamed
     if (a.mode!="static" && a.mode!="dynamic") usage(rank, argv[0]);
+    check_choice(rank, "--ingest", a.ingest, {"scatter", "mmap"});
+    check_choice(rank, "--schedule", a.schedule, {"lines", "bytes", "guided", "adaptive", "steal"});
+    check_choice(rank, "--reduce", a.reduce, {"gather", "tree", "shuffle"});
+    check_choice(rank, "--tokenizer", a.tokenizer, {"ascii", "utf8", "raw"});
+    if (a.ngram < 1 || a.ngram > kMaxNgram) {
+        int n = std::clamp(a.ngram, 1, kMaxNgram);
+        if (rank == 0) std::cerr << "--ngram must be 1.." << kMaxNgram << ", using " << n << "\n";
+        a.ngram = n;
+    }
+    if (a.resume && a.checkpoint_path.empty()) {
+        if (rank == 0) std::cerr << "--resume needs --checkpoint PATH; starting from scratch\n";
+        a.resume = false;
+    }
+    // Checkpoints and reassignment need every chunk's counts to come back with it.
+    if (a.accumulate && (!a.checkpoint_path.empty() || a.worker_timeout_ms > 0)) {
+        if (rank == 0) std::cerr << "--checkpoint / --worker-timeout-ms do not apply with --accumulate\n";
+        a.checkpoint_path.clear();
+        a.resume = false;
+        a.worker_timeout_ms = 0;
+    }
+    if (a.pipeline && (a.node_aware || a.approx)) {
+        if (rank == 0) std::cerr << "--pipeline does not combine with --node-aware or --approx; running unpipelined\n";
+        a.pipeline = false;
+    }
+    // Adaptive chunk sizes depend on timing, so chunk ids would not repeat on resume.
+    if (!a.checkpoint_path.empty() && a.schedule == "adaptive") {
+        if (rank == 0) std::cerr << "--checkpoint needs a reproducible chunk plan; using --schedule guided\n";
+        a.schedule = "guided";
+    }
     return a;
 }
 
-// make parse_args visible to other TUs
-Args parse_args(int, int, char**);
+// Sets count_options() / cut_options() on every rank. Rank 0 reads the stop-word
+// file and broadcasts it; each rank tokenizes it with the run's tokenizer, so stop
+// words match the words they are meant to drop.
+void finish_run(const Counter& global, const Args& a, const char* label, double ms) {
+    auto top = topN(global, a.topN);
+    std::cout << "\nTop " << a.topN << " words (" << label << "):\n";
+    print_topN(top);
+    std::cout << "\nTime: " << ms << " ms\n";
+    if (index_run().on()) index_run().commit(global);
+}
+
+static void configure_counting(const Args& a, int rank) {
+    CountOptions& o = count_options();
+    o.tokenizer = a.tokenizer == "utf8" ? TOK_UTF8 : a.tokenizer == "raw" ? TOK_RAW : TOK_ASCII;
+    o.ngram = a.ngram;
+    cut_options().lines = a.ngram > 1;
+    if (a.stopwords_path.empty()) return;
+
+    std::vector<char> text;
+    uint64_t n = 0;
+    if (rank == 0) {
+        std::ifstream f(a.stopwords_path, std::ios::binary);
+        if (!f) std::cerr << "cannot read --stopwords " << a.stopwords_path << ", keeping every word\n";
+        else text.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        n = text.size();
+    }
+    MPI_Bcast(&n, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    text.resize(n);
+    MPI_Bcast(text.data(), (int)n, MPI_CHAR, 0, MPI_COMM_WORLD); // a word list, far below 2 GiB
+    tokenize_as(o.tokenizer, text.data(), text.size(), [&](const char* t, size_t len) { o.stopwords.add(t, len); });
+}
 
 int main(int argc, char** argv) {
-    MPI_Init(&argc, &argv);
+    // OpenMP regions and the dynamic master's merge thread never call MPI.
+    int provided = 0;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     int rank=0, size=1;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
     if (argc < 3) { usage(rank, argv[0]); MPI_Finalize(); return 0; }
     Args args = parse_args(rank, argc, argv);
+    // Rank 0 decides, so every rank agrees even if some cannot see the path.
+    int multi = rank == 0 ? (int)is_multi_input(args.path) : 0;
+    MPI_Bcast(&multi, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    args.multi_input = multi;
+    // --schedule steal: every rank maps one regular file itself, and there is no
+    // master to checkpoint or reassign chunks.
+    if (args.mode == "dynamic" && args.schedule == "steal" &&
+        (args.stream || args.multi_input || !args.checkpoint_path.empty() || args.worker_timeout_ms > 0)) {
+        if (rank == 0)
+            std::cerr << "--schedule steal needs a single file, without --stream/--checkpoint/--worker-timeout-ms; "
+                         "using guided\n";
+        args.schedule = "guided";
+    }
+    if (args.approx && (args.mode != "static" || args.stream || args.node_aware || args.multi_input)) {
+        if (rank == 0)
+            std::cerr << "--approx applies to single-file static runs without --stream/--node-aware; counting exactly\n";
+        args.approx = 0;
+    } else if (args.approx && (args.tokenizer != "ascii" || args.ngram > 1 || !args.stopwords_path.empty())) {
+        if (rank == 0) std::cerr << "--approx counts single ascii words; ignoring --tokenizer/--ngram/--stopwords\n";
+        args.tokenizer = "ascii";
+        args.ngram = 1;
+        args.stopwords_path.clear();
+    }
+    if (args.approx && !args.index_path.empty()) {
+        if (rank == 0) std::cerr << "--index needs exact counts; not updating it with --approx\n";
+        args.index_path.clear();
+    }
+    configure_counting(args, rank);
+
+    // --index: rank 0 checks the index's key settings and whether a single input is
+    // already in it (multi-file modes drop indexed files as they list them). With
+    // nothing new to count every rank skips the run.
+    int fresh = 1;
+    if (!args.index_path.empty()) {
+        if (rank == 0) {
+            index_run().open(args.index_path);
+            if (!args.multi_input) fresh = index_run().is_new(args.path);
+        }
+        MPI_Bcast(&fresh, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    if (!fresh) {
+        if (rank == 0) {
+            std::cerr << "[index] " << args.path << " is already in " << args.index_path << ", nothing to count\n";
+            CountIndex idx(args.index_path);
+            std::vector<std::pair<std::string, uint64_t>> top;
+            for (size_t r = 0; r < idx.size() && (int)r < args.topN; ++r)
+                top.emplace_back(std::string(idx.key(idx.by_count(r))), idx.count(idx.by_count(r)));
+            std::cout << "\nTop " << args.topN << " words (index):\n";
+            print_topN(top);
+        }
+        MPI_Finalize();
+        return 0;
+    }
+    wire_options().compress = args.compress;
 
     if (rank == 0) {
         std::cerr << "Hybrid parallelism: " << size
@@ -60,10 +220,20 @@ int main(int argc, char** argv) {
                   << " OpenMP threads\n";
     }
 
+    // --stats / --trace: common time origin, then one collective report at the end.
+    stats().trace = !args.trace_path.empty();
+    stats().on = stats().trace || !args.stats_path.empty();
+    if (stats().on) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        stats().start();
+    }
+
     if (args.mode == "static")      run_static(args, rank, size);
     else if (args.mode == "dynamic") run_dynamic(args, rank, size);
     else usage(rank, argv[0]);
 
+    if (stats().on) stats().report(args.mode, args.stats_path, args.trace_path, MPI_COMM_WORLD);
+
     MPI_Finalize();
     return 0;
 }
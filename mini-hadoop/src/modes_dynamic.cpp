@@ -1,194 +1,552 @@
 #include <mpi.h>
 
+#include "args.hpp"
+#include "checkpoint.hpp"
+#include "comm.hpp"
+#include "corpus.hpp"
 #include "count.hpp"
+#include "index.hpp"
+#include "merge_thread.hpp"
+#include "reduce.hpp"
+#include "schedule.hpp"
+#include "steal.hpp"
+#include "stream.hpp"
 #include "utils.hpp"
 #include "viz.hpp"
 #include <chrono>
+#include <deque>
 #include <iostream>
+#include <optional>
+#include <sstream>
+#include <thread>
 
-struct Args {
-    std::string mode, path;
-    int topN = 20;
-    int chunk_lines = 400;
-    int bar_width = 50;
-};
+// Headers ({chunk id, payload bytes}) travel as TAG_WORK / TAG_STOP / TAG_DONE; the
+// payload that follows a header always uses TAG_DATA, so a worker can keep a
+// header receive (MPI_ANY_TAG over WORK/STOP) posted while payloads are in flight.
+enum { TAG_WORK=1, TAG_DONE=2, TAG_STOP=3, TAG_DATA=4 };
 
-extern Args parse_args(int rank, int argc, char** argv); // from main.cpp
+// --schedule steal: no master. Every rank maps the file itself (as with static
+// --ingest mmap), counts the chunks of its own range and steals from the others once
+// it runs dry (steal.hpp). Chunks are --chunk-bytes apart, each starting at the
+// first whitespace after its nominal offset, so any rank can cut any chunk on its
+// own. Counts accumulate in one Counter per rank and are combined with --reduce.
+static void run_dynamic_steal(const Args& a, int rank, int size) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::optional<MappedFile> f;
+    {
+        PhaseTimer timer(PH_READ);
+        f.emplace(a.path);
+    }
+    const char* d = f->data();
+    const size_t N = f->size();
+    const uint64_t B = std::max<uint64_t>(1, a.chunk_bytes);
+    const uint64_t C = (N + B - 1) / B;
+    auto cut = [&](uint64_t i) { return i == 0 ? 0 : i >= C ? N : next_ws(d, N, (size_t)(i * B)); };
 
-enum { TAG_WORK=1, TAG_DONE=2, TAG_STOP=3 };
+    Counter local;
+    uint64_t mine[3] = { 0, 0, 0 }; // bytes, chunks, chunks stolen
+    StealQueue q(C, MPI_COMM_WORLD);
+    const int threads = omp_get_max_threads();
+    for (;;) {
+        int64_t id;
+        {
+            PhaseTimer timer(PH_WAIT);
+            while ((id = q.take()) < 0 && q.steal()) {}
+        }
+        if (id < 0) break;
+        const size_t lo = cut((uint64_t)id), hi = cut((uint64_t)id + 1);
+        f->advise_sequential(lo, hi);
+        count_chunk_omp(d + lo, hi - lo, threads, local);
+        mine[0] += hi - lo;
+        ++mine[1];
+    }
+    mine[2] = q.stolen();
+    {
+        PhaseTimer timer(PH_WAIT);
+        q.finish(); // keeps answering the ranks still counting
+    }
+    f.reset();
+
+    reduce_counts(local, a.reduce, reduce_top(a), MPI_COMM_WORLD);
+    std::vector<uint64_t> per_rank(rank == 0 ? 3 * (size_t)size : 0);
+    MPI_Gather(mine, 3, MPI_UINT64_T, per_rank.data(), 3, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        print_steal_summary(per_rank, a.bar_width);
+        finish_run(local, a, "dynamic", ms);
+    }
+}
 
 void run_dynamic(const Args& a, int rank, int size) {
+    if (a.schedule == "steal") {
+        run_dynamic_steal(a, rank, size);
+        return;
+    }
     if (size < 2) {
         if (rank == 0) std::cerr << "dynamic mode requires at least 2 ranks.\n";
         return;
     }
 
     auto t0 = std::chrono::steady_clock::now();
+    const int K = std::max(1, a.prefetch); // chunks in flight per worker
 
     if (rank == 0) {
-        auto buf = slurp_file(a.path);
-
-        // line offsets
-        std::vector<size_t> line_starts; line_starts.reserve(1<<20);
-        line_starts.push_back(0);
-        for (size_t i=0;i<buf.size();++i) if (buf[i]=='\n') line_starts.push_back(i+1);
-        if (line_starts.back()!=buf.size()) line_starts.push_back(buf.size());
-        size_t num_lines = line_starts.size() - 1;
-
-        struct Chunk { int id; size_t a,b; size_t bytes() const { return b-a; } };
-        std::vector<Chunk> chunks; chunks.reserve(num_lines / a.chunk_lines + 2);
-        for (size_t i=0; i<num_lines;) {
-            size_t j = std::min(num_lines, i + (size_t)a.chunk_lines);
-            chunks.push_back({ (int)chunks.size(), line_starts[i], line_starts[j] });
-            i = j;
-        }
-        const int M = (int)chunks.size();
-
-        int next_idx = 0;
-        int active = 0;
-
         std::vector<size_t> bytes_assigned(size, 0), bytes_completed(size, 0);
-        size_t total_bytes = buf.size();
-        auto last_print = std::chrono::steady_clock::now();
-
-        // prime
-        for (int w=1; w<size && next_idx<M; ++w) {
-            auto &c = chunks[next_idx++];
-            int hdr[2] = { c.id, (int)c.bytes() };
-            MPI_Send(hdr, 2, MPI_INT, w, TAG_WORK, MPI_COMM_WORLD);
-            if (c.bytes()) MPI_Send(buf.data()+c.a, (int)c.bytes(), MPI_CHAR, w, TAG_WORK, MPI_COMM_WORLD);
-            bytes_assigned[w] += c.bytes();
-            active++;
+        double first_chunk_ms = -1;
+
+        // Chunk source. In memory: the whole file, cut on demand by the --schedule
+        // policy (see schedule.hpp). With --stream: windows read on a background
+        // thread (see stream.hpp), so the first chunk goes out before the rest of
+        // the input has been read and memory stays bounded by the chunks in flight.
+        // Multi-file input: work units of ~--chunk-bytes (see corpus.hpp); only the
+        // unit descriptors are sent, and the workers read the files themselves.
+        std::vector<char> buf;
+        std::optional<ChunkScheduler> chunks;
+        std::optional<ChunkStream> stream;
+        std::vector<WorkUnit> units;
+        size_t input_bytes = 0;
+        int issued = 0;
+        if (a.multi_input) {
+            PhaseTimer timer(PH_READ);
+            auto files = list_inputs(a.path);
+            if (index_run().on()) files = index_run().new_inputs(files);
+            for (auto& f : files) input_bytes += f.size;
+            units = pack_units(files, a.chunk_bytes);
+            if (a.schedule != "bytes")
+                std::cerr << "[dynamic] " << files.size() << " files in " << units.size()
+                          << " work units of ~--chunk-bytes; --schedule " << a.schedule << " not applied\n";
+        } else if (a.stream) {
+            ChunkRule rule;
+            if (a.schedule == "lines") rule.lines = (size_t)std::max(1, a.chunk_lines);
+            else rule.bytes = a.chunk_bytes;
+            if (a.schedule == "guided" || a.schedule == "adaptive")
+                std::cerr << "[dynamic] --stream: input size unknown, --schedule " << a.schedule
+                          << " uses fixed --chunk-bytes\n";
+            stream.emplace(a.path, a.window_bytes, rule, (size_t)(size - 1) * K);
+        } else {
+            PhaseTimer timer(PH_READ);
+            buf = slurp_file(a.path);
+            chunks.emplace(buf, a.schedule, a.chunk_lines, a.chunk_bytes, size - 1, K, bytes_completed);
         }
+        auto total_bytes = [&] { return stream ? stream->bytes_read() : a.multi_input ? input_bytes : buf.size(); };
 
+        // --checkpoint / --resume (checkpoint.hpp). The plan string pins down how the
+        // input is cut and counted, so a chunk id means the same bytes and keys in the
+        // resumed run.
         Counter global;
-        std::vector<char> tmp;
+        DoneSet done;
+        const bool checkpointing = !a.checkpoint_path.empty();
+        std::string plan;
+        if (checkpointing) {
+            std::ostringstream os;
+            os << "path=" << a.path << " bytes=" << (stream ? std::string("stream") : std::to_string(total_bytes()))
+               << " files=" << (a.multi_input ? std::to_string(units.size()) + "units" : std::string("1"));
+            if (a.multi_input) os << " chunk_bytes=" << a.chunk_bytes;
+            else if (a.schedule == "lines") os << " schedule=lines chunk_lines=" << a.chunk_lines;
+            else if (stream || a.schedule == "bytes") os << " schedule=bytes chunk_bytes=" << a.chunk_bytes;
+            else os << " schedule=" << a.schedule << " chunk_bytes=" << a.chunk_bytes
+                    << " workers=" << size - 1 << " prefetch=" << K;
+            if (stream) os << " window_bytes=" << a.window_bytes;
+            os << " tokenizer=" << a.tokenizer << " ngram=" << a.ngram
+               << " stopwords=" << count_options().stopwords.size();
+            plan = os.str();
+            if (a.resume && read_checkpoint(a.checkpoint_path, plan, done, global))
+                std::cerr << "[dynamic] resumed from " << a.checkpoint_path << ": " << done.count()
+                          << " chunks done, " << global.size() << " words\n";
+        }
+
+        // Dashboard / --status-file on a background thread (viz.hpp); the loop below
+        // only publishes counters to it.
+        ProgressReporter progress(size, a.progress_ms, a.bar_width, a.status_file);
+        progress.set_total(total_bytes());
+
+        // One chunk as handed to a worker, kept until its result is back so it can
+        // be handed to someone else if that worker is declared dead. In-memory
+        // chunks are an offset into 'buf', units an index; streamed chunks keep a
+        // copy of their bytes only when --worker-timeout may need to resend them.
+        struct Work { int64_t id; size_t nb; size_t a = 0; std::vector<char> data; };
+        // Each worker's in-flight chunks, oldest first: a worker returns results in
+        // the order it received chunks.
+        std::vector<std::deque<Work>> inflight(size);
+        std::deque<Work> requeue;     // taken from dead workers, handed out first
+        std::vector<int> idle;        // live workers with nothing in flight
+        std::vector<char> dead(size, 0);
+        int live = size - 1, lost = 0;
+        size_t skipped_bytes = 0;
+        const bool reassign = a.worker_timeout_ms > 0;
+
+        // Next chunk that is not done yet; false once the input is exhausted.
+        auto next_work = [&](int w, Work& out) {
+            if (!requeue.empty()) {
+                out = std::move(requeue.front());
+                requeue.pop_front();
+                return true;
+            }
+            for (;;) {
+                if (a.multi_input) {
+                    if (issued == (int)units.size()) return false;
+                    out = { issued, unit_bytes(units[issued]), 0, {} };
+                    ++issued;
+                } else if (stream) {
+                    std::vector<char> c;
+                    if (!stream->pop(c)) return false;
+                    out = { issued++, c.size(), 0, {} };
+                    out.data = std::move(c);
+                } else {
+                    if (chunks->empty()) return false;
+                    Chunk c = chunks->next(w);
+                    issued = chunks->issued();
+                    out = { c.id, c.bytes(), c.a, {} };
+                }
+                if (!done.contains(out.id)) return true;
+                skipped_bytes += out.nb;
+            }
+        };
+
+        // All sends are non-blocking: the master never waits for a worker to post
+        // its receive. In-memory payloads point straight into 'buf', which outlives
+        // the queue; streamed chunks are owned by the queue until sent.
+        SendQueue sends;
+        auto send_work = [&](int w, Work work) {
+            const size_t nb = work.nb;
+            if (a.multi_input) {
+                std::vector<char> desc;
+                encode_unit(units[(size_t)work.id], desc);
+                int64_t hdr[2] = { work.id, (int64_t)desc.size() };
+                sends.send_owned(pod_bytes(hdr), w, TAG_WORK, MPI_COMM_WORLD);
+                sends.send_owned(std::move(desc), w, TAG_DATA, MPI_COMM_WORLD);
+            } else if (stream) {
+                int64_t hdr[2] = { work.id, (int64_t)nb };
+                sends.send_owned(pod_bytes(hdr), w, TAG_WORK, MPI_COMM_WORLD);
+                sends.send_owned(reassign ? work.data : std::move(work.data), w, TAG_DATA, MPI_COMM_WORLD);
+            } else {
+                int64_t hdr[2] = { work.id, (int64_t)nb };
+                sends.send_owned(pod_bytes(hdr), w, TAG_WORK, MPI_COMM_WORLD);
+                sends.send_ref(buf.data() + work.a, nb, w, TAG_DATA, MPI_COMM_WORLD);
+            }
+            if (first_chunk_ms < 0)
+                first_chunk_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            bytes_assigned[w] += nb;
+            progress.assigned(w, nb);
+            progress.set_issued(issued);
+            if (stream) progress.set_total(total_bytes());
+            if (!reassign) work.data = {};
+            inflight[w].push_back(std::move(work));
+        };
+        // Sends worker w its next chunk; false once there is nothing left to send.
+        auto dispatch = [&](int w) {
+            Work work;
+            if (!next_work(w, work)) return false;
+            send_work(w, std::move(work));
+            return true;
+        };
+        auto stop = [&](int w) {
+            int64_t hdr[2] = { -1, 0 };
+            sends.send_owned(pod_bytes(hdr), w, TAG_STOP, MPI_COMM_WORLD);
+        };
+
+        // prime: K chunks per worker, dealt round-robin so the first wave is spread out
+        bool more = true;
+        for (int k=0; k<K && more; ++k)
+            for (int w=1; w<size && more; ++w) more = dispatch(w);
+        for (int w=1; w<size; ++w)
+            if (inflight[w].empty()) idle.push_back(w);
+
+        // Results are merged on a background thread; this loop only moves messages.
+        MergeThread merger(global);
+
+        // Checkpoints are written by the merge thread once every result received so
+        // far is merged, so the Counter and the done set always agree.
+        auto last_ckpt = std::chrono::steady_clock::now();
+        auto checkpoint = [&] {
+            merger.push_task([path = a.checkpoint_path, plan, snap = done](const Counter& g) {
+                try {
+                    write_checkpoint(path, plan, snap, g);
+                } catch (const std::exception& e) {
+                    std::cerr << "[dynamic] checkpoint failed: " << e.what() << "\n";
+                }
+            });
+            last_ckpt = std::chrono::steady_clock::now();
+        };
+
+        // --worker-timeout: a worker with chunks in flight that has sent nothing for
+        // that long is declared dead. Its chunks go back to the front of the queue,
+        // it gets no more work, and anything it still sends is read and dropped.
+        std::vector<std::chrono::steady_clock::time_point> last_heard(size, std::chrono::steady_clock::now());
+        auto reap_dead = [&] {
+            auto now = std::chrono::steady_clock::now();
+            for (int w = 1; w < size; ++w) {
+                if (dead[w] || inflight[w].empty()) continue;
+                if (std::chrono::duration<double, std::milli>(now - last_heard[w]).count() < a.worker_timeout_ms) continue;
+                std::cerr << "[dynamic] rank " << w << " silent for " << a.worker_timeout_ms << " ms with "
+                          << inflight[w].size() << " chunk(s) in flight; reassigning them\n";
+                dead[w] = 1;
+                --live;
+                ++lost;
+                for (auto it = inflight[w].rbegin(); it != inflight[w].rend(); ++it) requeue.push_front(std::move(*it));
+                inflight[w].clear();
+            }
+            // Idle workers pick the requeued chunks up at once.
+            while (!requeue.empty() && !idle.empty()) {
+                int w = idle.back();
+                idle.pop_back();
+                for (int k = 0; k < K && !requeue.empty(); ++k) {
+                    send_work(w, std::move(requeue.front()));
+                    requeue.pop_front();
+                }
+            }
+        };
+        auto in_flight = [&] {
+            for (int w = 1; w < size; ++w) if (!inflight[w].empty()) return true;
+            return false;
+        };
 
-        // 'active' tracks how many workers are still busy or awaiting further work.
-        // It is initially set when the master sends the first round of chunks (the "prime phase").
-        // Each worker that receives a TAG_STOP will decrement 'active' when they are fully done.
-        while (active > 0) {
+        // Loop until no chunk is out. A worker that drains with nothing left to hand
+        // out goes idle rather than being stopped, so chunks reclaimed from a dead
+        // worker can still go to it; every live worker gets TAG_STOP at the end.
+        while (in_flight() || !requeue.empty()) {
+            if (live == 0) {
+                // Nobody left to send to: count whatever remains here.
+                std::cerr << "[dynamic] no live workers left; counting the rest on rank 0\n";
+                Work w;
+                while (next_work(0, w)) {
+                    std::vector<char> text;
+                    const char* p = buf.data() + w.a;
+                    if (a.multi_input) {
+                        for (auto& pc : units[(size_t)w.id]) load_piece(pc, text);
+                        p = text.data();
+                    } else if (stream) {
+                        p = w.data.data();
+                    }
+                    std::vector<char> blob;
+                    serialize_counter(count_chunk_omp(p, a.multi_input ? text.size() : w.nb, omp_get_max_threads()), blob);
+                    merger.push(std::move(blob));
+                    done.add(w.id);
+                }
+                break;
+            }
             MPI_Status st;
-            int meta[2]; // [chunk_id, payload_size]
+            int64_t meta[2]; // [chunk_id, payload_size]
 
             // --- (1) Wait for any worker to finish a chunk ---
             // Blocks until *any* worker sends a TAG_DONE message with its result metadata.
             // Using MPI_ANY_SOURCE allows fully dynamic, event-driven scheduling.
-            MPI_Recv(meta, 2, MPI_INT, MPI_ANY_SOURCE, TAG_DONE, MPI_COMM_WORLD, &st); // which worker rank finished
-            const int src = st.MPI_SOURCE;                                             // chunk ID that was processed
-            const int cid = meta[0], psz = meta[1];                                    // serialized payload size (bytes)
+            // With --worker-timeout the wait polls, checking for silent workers.
+            {
+                PhaseTimer timer(PH_WAIT);
+                if (reassign) {
+                    int flag = 0;
+                    MPI_Iprobe(MPI_ANY_SOURCE, TAG_DONE, MPI_COMM_WORLD, &flag, &st);
+                    if (!flag) {
+                        reap_dead();
+                        std::this_thread::sleep_for(std::chrono::microseconds(100));
+                        continue;
+                    }
+                }
+                MPI_Recv(meta, sizeof meta, MPI_BYTE, reassign ? st.MPI_SOURCE : MPI_ANY_SOURCE, TAG_DONE,
+                         MPI_COMM_WORLD, &st); // which worker rank finished
+            }
+            const int src = st.MPI_SOURCE;                                                     // chunk ID that was processed
+            const size_t psz = (size_t)meta[1];                                                // serialized payload size (bytes)
 
             // --- (2) Receive serialized Counter payload from that worker ---
-            tmp.resize(psz);
-            if (psz) MPI_Recv(tmp.data(), psz, MPI_CHAR, src, TAG_DONE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            // --- (3) Deserialize and merge the worker's partial word counts ---
-            Counter part; if (psz) deserialize_counter(tmp.data(), tmp.size(), part);
-            merge_into(global, part);
+            // (split into <=1 GiB pieces by recv_bytes, so blob size is not int-limited)
+            std::vector<char> blob(psz);
+            {
+                PhaseTimer timer(PH_COMM);
+                recv_bytes(blob.data(), psz, src, TAG_DATA, MPI_COMM_WORLD);
+            }
+            if (dead[src]) continue; // late result of a chunk that was reassigned
+            last_heard[src] = std::chrono::steady_clock::now();
+
+            // --- (3) Hand it to the merge thread; merging overlaps with dispatch ---
+            merger.push(std::move(blob));
 
             // --- (4) Update progress statistics for this worker - to show dynamic workload ---
-            size_t bytes_this = 0;
-            if (cid >= 0 && cid < M) bytes_this = chunks[cid].bytes();
-            bytes_completed[src] += bytes_this;
-
-            // assign next or stop
-            if (next_idx < M) {
-                // Still have remaining chunks → immediately assign the next one
-                auto &c = chunks[next_idx++];
-                int hdr[2] = { c.id, (int)c.bytes() };
-                // Send new work header and payload
-                MPI_Send(hdr, 2, MPI_INT, src, TAG_WORK, MPI_COMM_WORLD);
-                if (c.bytes()) MPI_Send(buf.data()+c.a, (int)c.bytes(), MPI_CHAR, src, TAG_WORK, MPI_COMM_WORLD);
-                bytes_assigned[src] += c.bytes();
-            } else
-                // No remaining chunks → tell this worker to stop and mark inactive
-                int stop[2] = { -1, 0 };
-                MPI_Send(stop, 2, MPI_INT, src, TAG_STOP, MPI_COMM_WORLD);
-                active--;
-            }
+            Work fin = std::move(inflight[src].front());
+            inflight[src].pop_front();
+            bytes_completed[src] += fin.nb;
+            progress.completed(src, fin.nb);
+            if (!a.accumulate) done.add(fin.id);
 
-            // occasional dashboard
-            auto now = std::chrono::steady_clock::now();
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_print).count() > 250) {
-                last_print = now;
-                print_dynamic_progress(total_bytes, bytes_assigned, bytes_completed,
-                                       a.bar_width, next_idx, M);
-            }
+            // --- (5) Top the worker back up to K in flight, or park it once drained ---
+            if ((more || !requeue.empty()) && !dispatch(src)) more = false;
+            if (inflight[src].empty()) idle.push_back(src);
+            sends.reap();
+
+            if (checkpointing && std::chrono::duration<double, std::milli>(last_heard[src] - last_ckpt).count() >= a.checkpoint_ms)
+                checkpoint();
+            if (reassign) reap_dead();
         }
+        for (int w : idle) stop(w);
+
+        if (stream) progress.set_total(total_bytes());
+        progress.stop();
+        if (checkpointing) checkpoint();
+        merger.finish();
+        if (!lost) {
+            PhaseTimer timer(PH_COMM);
+            sends.wait_all();
+        }
+        stats().note_table(global.size());
+
+        // --accumulate: workers still hold everything not yet flushed as a delta.
+        // Collect it with the same reduction strategies static mode uses; the
+        // master takes part with 'global' as its local share.
+        if (a.accumulate) reduce_counts(global, a.reduce, reduce_top(a), MPI_COMM_WORLD);
 
         auto t1 = std::chrono::steady_clock::now();
         double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
 
         print_dynamic_assigned(bytes_assigned, a.bar_width);
+        if (stream)
+            std::cerr << "\n[dynamic] streamed " << total_bytes() << "B in " << issued
+                      << " chunks, first chunk sent after " << first_chunk_ms << " ms\n";
+        if (done.count() && skipped_bytes)
+            std::cerr << "\n[dynamic] skipped " << skipped_bytes << "B already in the checkpoint\n";
 
-        auto top = topN(global, a.topN);
-        std::cout << "\nTop " << a.topN << " words (dynamic):\n";
-        print_topN(top);
-        std::cout << "\nTime: " << ms << " ms\n";
+        finish_run(global, a, "dynamic", ms);
+
+        if (lost) {
+            // A lost rank can never join MPI_Finalize; the results above are complete,
+            // so end the job here.
+            std::cout << std::flush;
+            std::cerr << "[dynamic] " << lost << " worker(s) lost; aborting the job after printing results\n" << std::flush;
+            MPI_Abort(MPI_COMM_WORLD, 0);
+        }
     } else {
         // ===============================================================
         //  WORKER SECTION (executed by ranks > 0)
         //
-        //  Each worker repeatedly waits for commands from the master (rank 0).
+        //  Each worker consumes commands from the master (rank 0).
         //  The master controls the workflow using MPI message tags:
         //
-        //    TAG_WORK → process a new chunk of text
+        //    TAG_WORK → a new chunk of text follows (as TAG_DATA)
         //    TAG_STOP → terminate cleanly
         //
-        //  The loop runs indefinitely until a TAG_STOP is received.
+        //  The master keeps up to K (--prefetch) chunks in flight per worker, so
+        //  while one chunk is being counted the next ones are already arriving:
+        //  a header receive is always posted, and as soon as a header lands the
+        //  payload receive for it is posted too. Results go back with MPI_Isend.
+        //
+        //  With multi-file input the payload is a work-unit descriptor (corpus.hpp):
+        //  descriptors that have arrived are handed to a UnitLoader thread at once,
+        //  so the files of the next units are read while this one is counted.
+        //
+        //  With --accumulate the worker counts into one persistent Counter and
+        //  answers each chunk with a bare ack (payload size 0), attaching the
+        //  accumulated delta only once it outgrows --flush-bytes. Whatever is left
+        //  at TAG_STOP is collected by reduce_counts after the loop.
         //
         // ===============================================================
+        struct Slot { int64_t cid; std::vector<char> data; std::vector<MPI_Request> reqs; bool loading = false; };
+        std::deque<Slot> ready;   // headers received, payload receives posted
+        SendQueue results;
+        bool stopped = false;
+        Counter acc; // --accumulate only
+        std::optional<UnitLoader> loader; // multi-file input only
+        if (a.multi_input) loader.emplace((size_t)K);
+
+        // Multi-file: start loading every unit whose descriptor is complete, in order.
+        auto start_loads = [&] {
+            for (Slot& s : ready) {
+                if (s.loading) continue;
+                int done = 1;
+                if (!s.reqs.empty()) MPI_Testall((int)s.reqs.size(), s.reqs.data(), &done, MPI_STATUSES_IGNORE);
+                if (!done) return;
+                loader->submit(decode_unit(s.data.data(), s.data.size()));
+                s.loading = true;
+            }
+        };
+
+        int64_t hdr[2];
+        MPI_Status st;
+        MPI_Request hreq;
+        // --- (1) Keep one header receive posted at all times ---
+        //
+        //   hdr[0] = chunk ID (or -1 for stop)
+        //   hdr[1] = number of bytes in payload
+        //
+        // MPI_ANY_TAG allows this to handle both TAG_WORK and TAG_STOP messages.
+        MPI_Irecv(hdr, sizeof hdr, MPI_BYTE, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &hreq);
+
+        // --- (2) A header arrived: start its payload transfer, re-arm the header receive ---
+        auto on_header = [&] {
+            if (st.MPI_TAG == TAG_STOP) { stopped = true; return; }
+            Slot s{ hdr[0], std::vector<char>((size_t)hdr[1]), {} };
+            irecv_bytes(s.data.data(), s.data.size(), 0, TAG_DATA, MPI_COMM_WORLD, s.reqs);
+            ready.push_back(std::move(s));
+            MPI_Irecv(hdr, sizeof hdr, MPI_BYTE, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &hreq);
+        };
+
         for (;;) {
-            MPI_Status st;
-            int hdr[2];
-            // --- (1) Wait for a command from the master ---
-            //
-            // The worker blocks here until the master sends *any* message.
-            // The header always contains:
-            //   hdr[0] = chunk ID (or -1 for stop)
-            //   hdr[1] = number of bytes in payload
-            //
-            // MPI_ANY_TAG allows this to handle both TAG_WORK and TAG_STOP messages.
-            MPI_Recv(hdr, 2, MPI_INT, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &st);
+            // Drain every header that has already arrived, without blocking.
+            int flag = 1;
+            while (!stopped && flag) {
+                MPI_Test(&hreq, &flag, &st);
+                if (flag) on_header();
+            }
+            if (ready.empty()) {
+                if (stopped) break;
+                {
+                    PhaseTimer timer(PH_WAIT);
+                    MPI_Wait(&hreq, &st);
+                }
+                on_header();
+                continue;
+            }
+
+            // --- (3) Finish receiving the oldest chunk (usually already here) ---
+            if (loader) start_loads();
+            Slot cur = std::move(ready.front());
+            ready.pop_front();
+            if (!cur.reqs.empty()) {
+                PhaseTimer timer(PH_WAIT);
+                MPI_Waitall((int)cur.reqs.size(), cur.reqs.data(), MPI_STATUSES_IGNORE);
+            }
+            if (loader) {
+                if (!cur.loading) loader->submit(decode_unit(cur.data.data(), cur.data.size()));
+                PhaseTimer timer(PH_READ);
+                cur.data = loader->take();
+            }
 
-            // --- (2) Check message type ---
+            // --- (4) Perform local computation on this chunk -> count.hpp to find what it does ---
             //
-            // TAG_STOP → no more work; break out of loop and exit.
-            // TAG_WORK → process the given chunk.
-            if (st.MPI_TAG == TAG_STOP) break;
-            if (st.MPI_TAG == TAG_WORK) {
-                int cid = hdr[0], nb = hdr[1];
-                std::vector<char> chunk(nb);
-
-                // --- (3) Receive the actual chunk data ---
-                //
-                // Only receive if there is a nonzero byte payload.
-                // The chunk represents a segment of the input file.
-                if (nb) MPI_Recv(chunk.data(), nb, MPI_CHAR, 0, TAG_WORK, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-                // --- (4) Perform local computation on this chunk -> count.hpp to find what it does ---
-                //
-                // Each worker count words
-                // within its assigned chunk.
-                // The function returns a local Counter (string → count map).
-                Counter local = count_chunk_omp(chunk.data(), chunk.size(), omp_get_max_threads());
-
-
-                std::vector<char> blob;
+            // Each worker count words
+            // within its assigned chunk.
+            // The function returns a local Counter (string → count map).
+            std::vector<char> blob;
+            if (a.accumulate) {
+                count_chunk_omp(cur.data.data(), cur.data.size(), omp_get_max_threads(), acc);
+                if (a.flush_bytes && acc.memory_bytes() >= a.flush_bytes) {
+                    serialize_counter(acc, blob);
+                    acc.clear();
+                }
+            } else {
+                Counter local = count_chunk_omp(cur.data.data(), cur.data.size(), omp_get_max_threads());
                 serialize_counter(local, blob);
-                int meta[2] = { cid, (int)blob.size() };
-                // --- (6) Send completion metadata first ---
-                //
-                //   meta[0] = chunk ID
-                //   meta[1] = size of serialized payload
-                //
-                // Sent with TAG_DONE to signal master that work is complete.
-                MPI_Send(meta, 2, MPI_INT, 0, TAG_DONE, MPI_COMM_WORLD);
-                // --- (7) Then send the actual serialized Counter payload ---
-                //
-                // This two-step protocol (meta + blob) lets the master allocate
-                // exactly the right amount of receive buffer memory.
-                if (!blob.empty()) MPI_Send(blob.data(), (int)blob.size(), MPI_CHAR, 0, TAG_DONE, MPI_COMM_WORLD);
             }
+            // --- (5) Send completion metadata, then the serialized Counter ---
+            //
+            //   meta[0] = chunk ID
+            //   meta[1] = size of serialized payload
+            //
+            // This two-step protocol (meta + blob) lets the master allocate
+            // exactly the right amount of receive buffer memory. Both sends are
+            // non-blocking, so the worker moves straight on to the next chunk.
+            int64_t meta[2] = { cur.cid, (int64_t)blob.size() };
+            results.send_owned(pod_bytes(meta), 0, TAG_DONE, MPI_COMM_WORLD);
+            results.send_owned(std::move(blob), 0, TAG_DATA, MPI_COMM_WORLD);
+            results.reap();
         }
+        {
+            PhaseTimer timer(PH_COMM);
+            results.wait_all();
+        }
+
+        if (a.accumulate) reduce_counts(acc, a.reduce, reduce_top(a), MPI_COMM_WORLD);
     }
 }
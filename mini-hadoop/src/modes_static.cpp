@@ -1,122 +1,557 @@
 #include <mpi.h>
 
+#include "args.hpp"
+#include "comm.hpp"
+#include "corpus.hpp"
 #include "count.hpp"
+#include "index.hpp"
+#include "merge_thread.hpp"
+#include "node.hpp"
+#include "reduce.hpp"
+#include "sketch.hpp"
+#include "stream.hpp"
 #include "utils.hpp"
 #include "viz.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <iostream>
+#include <optional>
 
-struct Args {
-    std::string mode, path;
-    int topN = 20;
-    int chunk_lines = 400; // unused in static
-    int bar_width = 50;
-};
+// Range [lo, hi) of a mapped corpus for 'rank' of 'size', cut at whitespace.
+static void mmap_range(const MappedFile& f, int rank, int size, MPI_Comm comm, size_t& lo, size_t& hi) {
+    const size_t N = f.size();
 
-extern Args parse_args(int rank, int argc, char** argv); // from main.cpp
+    // My start: nominal cut advanced to whitespace (same rule as whitespace_cuts).
+    // This only reads the tail of whatever token straddles the nominal cut.
+    lo = (N * (size_t)rank) / (size_t)size;
+    if (rank != 0) lo = next_ws(f.data(), N, lo);
 
-void run_static(const Args& a, int rank, int size) {
-    auto t0 = std::chrono::steady_clock::now();
+    // Boundary fix-up: my start is my left neighbour's end, so pass it left
+    // and take my end from the right neighbour.
+    uint64_t my_lo = lo, my_hi = N;
+    int left  = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    int right = rank + 1 < size ? rank + 1 : MPI_PROC_NULL;
+    MPI_Sendrecv(&my_lo, 1, MPI_UINT64_T, left, 0,
+                 &my_hi, 1, MPI_UINT64_T, right, 0, comm, MPI_STATUS_IGNORE);
+    hi = (size_t)my_hi;
+}
+
+// --node-aware: one copy of the input and one counter per node.
+//
+//   (1) Node leaders split the corpus into one slice per node (scatter from rank 0,
+//       or each leader reads its own range with --ingest mmap) straight into an
+//       MPI-3 shared window.
+//   (2) Every rank on the node counts its sub-range of that window in place.
+//   (3) Ranks publish their serialized counters in a second shared window and the
+//       leader merges them without any message passing.
+//   (4) Only the leaders run the --reduce strategy, over the leaders communicator.
+static void run_static_node_aware(const Args& a, int rank, int size,
+                                  std::chrono::steady_clock::time_point t0) {
+    NodeTopology topo(MPI_COMM_WORLD);
 
-    std::vector<int> sendcounts(size, 0), displs(size, 0);
+    // --- (1) node slice -> shared memory, owned by the leader ---
     std::vector<char> filebuf;
+    std::vector<size_t> node_counts(topo.n_nodes, 0), node_displs(topo.n_nodes, 0);
+    std::optional<MappedFile> mapped;
+    size_t src_lo = 0;
+    uint64_t slice = 0;
+    if (topo.leader()) {
+        if (a.ingest == "mmap") {
+            PhaseTimer timer(PH_READ);
+            mapped.emplace(a.path);
+            size_t hi = 0;
+            mmap_range(*mapped, topo.node_id, topo.n_nodes, topo.leaders, src_lo, hi);
+            slice = hi - src_lo;
+        } else {
+            if (rank == 0) {
+                PhaseTimer timer(PH_READ);
+                filebuf = slurp_file(a.path);
+                whitespace_cuts(filebuf, topo.n_nodes, node_counts, node_displs);
+            }
+            PhaseTimer timer(PH_SCATTER);
+            MPI_Scatter(node_counts.data(), 1, MPI_UINT64_T, &slice, 1, MPI_UINT64_T, 0, topo.leaders);
+        }
+    }
+    MPI_Bcast(&slice, 1, MPI_UINT64_T, 0, topo.node);
+
+    Counter local;
+    uint64_t mycount = 0;
+    {
+        SharedSegment input(topo.leader() ? slice : 0, topo.node);
+        if (topo.leader()) {
+            if (mapped) {
+                PhaseTimer timer(PH_READ);
+                mapped->advise_sequential(src_lo, src_lo + slice);
+                if (slice) std::memcpy(input.data(), mapped->data() + src_lo, slice);
+            } else {
+                PhaseTimer timer(PH_SCATTER);
+                scatterv_bytes(rank == 0 ? filebuf.data() : nullptr, node_counts, node_displs,
+                               input.data(), slice, 0, topo.leaders);
+            }
+        }
+        input.fence();
+        filebuf = {};
+        mapped.reset();
+
+        // --- (2) my share of the node slice, cut with the usual whitespace rule ---
+        size_t n = 0;
+        const char* text = input.peer(0, n);
+        const size_t r = topo.node_rank, R = topo.node_size;
+        size_t lo = r ? next_ws(text, n, n * r / R) : 0;
+        size_t hi = r + 1 < R ? next_ws(text, n, n * (r + 1) / R) : n;
+        mycount = hi - lo;
+        local = count_chunk_omp(text + lo, hi - lo, omp_get_max_threads());
+    }
+
+    // --- (3) intra-node merge through shared memory (never compressed: no wire) ---
+    {
+        std::vector<char> blob;
+        if (!topo.leader()) serialize_counter(local, blob, false);
+        SharedSegment out(blob.size(), topo.node);
+        if (!blob.empty()) std::memcpy(out.data(), blob.data(), blob.size());
+        out.fence();
+        if (topo.leader()) {
+            for (int r = 1; r < topo.node_size; ++r) {
+                size_t n = 0;
+                const char* p = out.peer(r, n);
+                if (n) merge_serialized(local, p, n);
+            }
+        }
+    }
+
+    // --- (4) inter-node reduction among leaders only ---
+    if (topo.leader()) reduce_counts(local, a.reduce, reduce_top(a), topo.leaders);
+
+    std::vector<size_t> sendcounts(size, 0);
+    MPI_Gather(&mycount, 1, MPI_UINT64_T, sendcounts.data(), 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
     if (rank == 0) {
-        filebuf = slurp_file(a.path);
-        whitespace_cuts(filebuf, size, sendcounts, displs);
-    }
-
-    int mycount = 0;
-    // ------------------------------------------------------------------------
-    // (1) MPI_Scatter
-    // ------------------------------------------------------------------------
-    // Distribute the number of bytes each rank should process.
-    // Rank 0 sends one integer (sendcounts[r]) to each rank.
-    // Every rank receives its own 'mycount' (local chunk size).
-    // Effectively, each process learns how many bytes it will receive next.
-    MPI_Scatter(sendcounts.data(), 1, MPI_INT, &mycount, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-    std::vector<char> mychunk(mycount);
-    // ------------------------------------------------------------------------
-    // (2) MPI_Scatterv
-    // ------------------------------------------------------------------------
-    // Distribute the actual file data.
-    //
-    // - On rank 0: 'filebuf' contains the entire file.
-    //   The 'sendcounts' array defines how many bytes go to each rank.
-    //   The 'displs' array defines the starting offset for each rank’s data.
-    //
-    // - On all other ranks: the receive buffer 'mychunk' will be filled with
-    //   exactly 'mycount' bytes assigned to that process.
-    //
-    // Result: Each rank now has its local text segment to process independently.
-    MPI_Scatterv(rank == 0 ? filebuf.data() : nullptr, sendcounts.data(), displs.data(),
-                 MPI_CHAR, mychunk.data(), mycount, MPI_CHAR, 0, MPI_COMM_WORLD);
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        std::cerr << "\n[static] node-aware: " << topo.n_nodes << " node(s), leader merges "
+                  << topo.node_size << " rank(s) on node 0\n";
+        print_static_bytes(sendcounts, a.bar_width);
+
+        finish_run(local, a, "static", ms);
+    }
+}
+
+// --stream: rank 0 reads the input (file, pipe or stdin) one --window-bytes window
+// at a time on a background thread, and each window is scattered and counted like
+// a whole file would be, accumulating into one Counter per rank. The next window is
+// read while the current one is being counted; memory is bounded by the window.
+static void run_static_stream(const Args& a, int rank, int size,
+                              std::chrono::steady_clock::time_point t0) {
+    std::optional<ChunkStream> stream;
+    if (rank == 0) {
+        ChunkRule rule;
+        rule.bytes = a.window_bytes;
+        stream.emplace(a.path, a.window_bytes, rule, 2);
+    }
+
+    Counter local;
+    std::vector<size_t> totals(size, 0);
+    std::vector<char> window, mychunk;
+    int rounds = 0;
+    for (;; ++rounds) {
+        int more = 0;
+        if (rank == 0) {
+            PhaseTimer timer(PH_READ);
+            more = (int)stream->pop(window);
+        }
+        MPI_Bcast(&more, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (!more) break;
+
+        // Same two steps as the whole-file scatter path in run_static, per window.
+        {
+            PhaseTimer timer(PH_SCATTER);
+            std::vector<size_t> sendcounts(size, 0), displs(size, 0);
+            if (rank == 0) {
+                whitespace_cuts(window, size, sendcounts, displs);
+                for (int r = 0; r < size; ++r) totals[r] += sendcounts[r];
+            }
+            uint64_t mycount = 0;
+            MPI_Scatter(sendcounts.data(), 1, MPI_UINT64_T, &mycount, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+            mychunk.resize(mycount);
+            scatterv_bytes(rank == 0 ? window.data() : nullptr, sendcounts, displs,
+                           mychunk.data(), mycount, 0, MPI_COMM_WORLD);
+        }
+
+        count_chunk_omp(mychunk.data(), mychunk.size(), omp_get_max_threads(), local);
+    }
+
+    reduce_counts(local, a.reduce, reduce_top(a), MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        std::cerr << "\n[static] streamed " << stream->bytes_read() << "B in " << rounds << " window(s)\n";
+        print_static_bytes(totals, a.bar_width);
+
+        finish_run(local, a, "static", ms);
+    }
+}
+
+// Multi-file input: rank 0 lists the files once and broadcasts the list; every rank
+// then takes an equal byte range of the files laid end to end and reads it itself,
+// in --window-bytes pieces loaded on a background thread while the previous piece
+// is being counted. No corpus bytes pass through rank 0.
+static void run_static_files(const Args& a, int rank, int size,
+                             std::chrono::steady_clock::time_point t0) {
+    std::vector<InputFile> files;
+    {
+        PhaseTimer timer(PH_READ);
+        if (rank == 0) files = list_inputs(a.path);
+        if (rank == 0 && index_run().on()) files = index_run().new_inputs(files);
+        bcast_inputs(files, 0, MPI_COMM_WORLD);
+    }
+
+    uint64_t total = 0;
+    for (auto& f : files) total += f.size;
+    const uint64_t lo = total * (uint64_t)rank / (uint64_t)size;
+    const uint64_t hi = total * (uint64_t)(rank + 1) / (uint64_t)size;
+
+    Counter local;
+    {
+        UnitLoader loader(2);
+        WorkUnit mine = range_pieces(files, lo, hi, a.window_bytes);
+        for (auto& pc : mine) loader.submit({ pc });
+        for (size_t i = 0; i < mine.size(); ++i) {
+            std::vector<char> text;
+            {
+                PhaseTimer timer(PH_READ);
+                text = loader.take();
+            }
+            count_chunk_omp(text.data(), text.size(), omp_get_max_threads(), local);
+        }
+    }
+
+    reduce_counts(local, a.reduce, reduce_top(a), MPI_COMM_WORLD);
+
+    std::vector<size_t> sendcounts(size, 0);
+    uint64_t mycount = hi - lo;
+    MPI_Gather(&mycount, 1, MPI_UINT64_T, sendcounts.data(), 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
-    // OpenMP counting
-    Counter local = count_chunk_omp(mychunk.data(), mychunk.size(), omp_get_max_threads());
-
-    // Serialize & variable-size gather to rank 0
-    std::vector<char> blob;
-    serialize_counter(local, blob);
-    int mysz = (int)blob.size();
-
-    std::vector<int> sizes(size, 0), disps(size, 0);
-
-    // ------------------------------------------------------------------------
-    // (3) MPI_Gather
-    // ------------------------------------------------------------------------
-    // First gather the size of each worker's serialized result.
-    //
-    // - Each rank sends its local 'mysz' (result byte size) to the master.
-    // - Rank 0 collects all these sizes into 'sizes'.
-    //
-    // This allows rank 0 to compute exact displacements for the next step.
-    MPI_Gather(&mysz, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-    std::vector<char> recvbuf;
     if (rank == 0) {
-        int total = 0; for (int s : sizes) total += s;
-        recvbuf.resize(total);
-        for (int r = 1; r < size; ++r) disps[r] = disps[r-1] + sizes[r-1];
-    }
-
-    // ------------------------------------------------------------------------
-    // (4) MPI_Gatherv
-    // ------------------------------------------------------------------------
-    // Collect the actual serialized word count results.
-    //
-    // - Each worker sends its 'blob' (serialized Counter).
-    // - Rank 0 receives variable-sized blobs, placed contiguously into 'recvbuf'.
-    //   The 'sizes' array gives the byte length per rank,
-    //   and 'disps' gives the byte offset for each.
-    //
-    // After this, rank 0 holds *all* partial word count results in 'recvbuf',
-    // ready to be deserialized and merged.
-    MPI_Gatherv(blob.data(), mysz, MPI_CHAR,
-                rank == 0 ? recvbuf.data() : nullptr,
-                sizes.data(), disps.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        std::cerr << "\n[static] " << files.size() << " input files, " << total << "B\n";
+        print_static_bytes(sendcounts, a.bar_width);
+
+        finish_run(local, a, "static", ms);
+    }
+}
+
+// --pipeline: the single-input paths as a pipeline of rounds instead of read,
+// scatter, count and reduce one after another. Each round moves about
+// --block-bytes per rank. While round k is counted:
+//   - scatter ingest: rank 0's reader thread reads ahead (stream.hpp) and round
+//     k+1 is already on its way with MPI_Iscatterv; --ingest mmap: every rank
+//     asks the kernel for its next block (MADV_WILLNEED) while counting this one;
+//   - the partial counts of earlier rounds travel to whoever merges them, rank 0
+//     (--reduce gather) or each key's owner (--reduce shuffle), and a merge thread
+//     there folds them in as they arrive.
+// MPI moves non-blocking transfers only inside MPI calls, so a round is counted
+// in kPollBytes slices with a test of the outstanding requests in between.
+// --reduce tree has no per-round form: its counts are reduced once at the end.
+
+constexpr int TAG_PIPE = 903; // per-round partial counts (see TAG_BULK, TAG_REDUCE)
+constexpr size_t kPollBytes = 1 << 20;
+
+static void run_static_pipeline(const Args& a, int rank, int size,
+                                std::chrono::steady_clock::time_point t0) {
+    const bool mmap_in = a.ingest == "mmap" && !a.stream;
+    const bool tree = a.reduce == "tree", shuffle = a.reduce == "shuffle";
+    // A round's window goes out in one int-counted MPI_Iscatterv.
+    const size_t B = std::clamp<size_t>(a.block_bytes, 1, kMaxMsgBytes / (size_t)size);
+    const int threads = omp_get_max_threads();
+
+    // --- partial counts: every sender sends each merger one blob per round ---
+    // A blob is a 64-bit length, then the bytes (split past kMaxMsgBytes by
+    // isend_bytes), all under TAG_PIPE: messages from one sender arrive in order,
+    // so a probe only ever matches a length.
+    Counter merged;  // gather: the global counts (rank 0); shuffle: my shard
+    Counter part;    // this round's counts (tree: all of them)
+    std::optional<MergeThread> merger;
+    if (!tree && (shuffle || rank == 0)) merger.emplace(merged);
+    SendQueue sends;
+    uint64_t received = 0;
+    auto send_part = [&](std::vector<char> blob, int dest) {
+        const uint64_t n = blob.size();
+        sends.send_owned(pod_bytes(n), dest, TAG_PIPE, MPI_COMM_WORLD);
+        sends.send_owned(std::move(blob), dest, TAG_PIPE, MPI_COMM_WORLD);
+    };
+    auto recv_part = [&](const MPI_Status& st) {
+        uint64_t n = 0;
+        std::vector<char> blob;
+        {
+            PhaseTimer timer(PH_COMM);
+            MPI_Recv(&n, sizeof n, MPI_CHAR, st.MPI_SOURCE, TAG_PIPE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            blob.resize(n);
+            recv_bytes(blob.data(), blob.size(), st.MPI_SOURCE, TAG_PIPE, MPI_COMM_WORLD);
+        }
+        merger->push(std::move(blob));
+        ++received;
+    };
+    auto drain = [&] {
+        for (;;) {
+            int flag = 0;
+            MPI_Status st;
+            MPI_Iprobe(MPI_ANY_SOURCE, TAG_PIPE, MPI_COMM_WORLD, &flag, &st);
+            if (!flag) return;
+            recv_part(st);
+        }
+    };
+    auto ship = [&] {
+        if (tree) return;
+        if (shuffle) {
+            std::vector<std::vector<char>> out;
+            serialize_partitioned(part, size, out);
+            for (int r = 0; r < size; ++r) {
+                if (r == rank) merger->push(std::move(out[r]));
+                else send_part(std::move(out[r]), r);
+            }
+        } else {
+            std::vector<char> blob;
+            serialize_counter(part, blob);
+            if (rank == 0) merger->push(std::move(blob));
+            else send_part(std::move(blob), 0);
+        }
+        part.clear();
+    };
+
+    // Counts [p, p+n) into 'part', keeping the next round's scatter and the partials moving.
+    MPI_Request* pending = nullptr;
+    auto count_polling = [&](const char* p, size_t n) {
+        for (size_t pos = 0; pos < n;) {
+            const size_t end = n - pos <= kPollBytes ? n : next_ws(p, n, pos + kPollBytes);
+            count_chunk_omp(p + pos, end - pos, threads, part);
+            pos = end;
+            int flag = 0;
+            if (pending) MPI_Test(pending, &flag, MPI_STATUS_IGNORE);
+            if (merger) drain();
+            sends.reap();
+        }
+    };
+
+    std::vector<size_t> sendcounts(size, 0);
+    uint64_t rounds = 0;
+    if (mmap_in) {
+        MappedFile f(a.path);
+        size_t lo = 0, hi = 0;
+        {
+            PhaseTimer timer(PH_READ);
+            mmap_range(f, rank, size, MPI_COMM_WORLD, lo, hi);
+        }
+        // The same number of rounds everywhere, so every merger knows what to expect.
+        rounds = std::max<uint64_t>(1, (hi - lo + B - 1) / B);
+        MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+        auto cut = [&](uint64_t k) {
+            return k == 0 ? lo : k >= rounds ? hi : next_ws(f.data(), hi, lo + (hi - lo) * k / rounds);
+        };
+        f.advise_sequential(cut(0), cut(1));
+        for (uint64_t k = 0; k < rounds; ++k) {
+            f.advise_sequential(cut(k + 1), cut(k + 2));
+            count_polling(f.data() + cut(k), cut(k + 1) - cut(k));
+            ship();
+        }
+        uint64_t mycount = hi - lo;
+        MPI_Gather(&mycount, 1, MPI_UINT64_T, sendcounts.data(), 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    } else {
+        // Scatter ingest, double-buffered: round k+1 is posted before round k is counted.
+        std::optional<ChunkStream> stream;
+        if (rank == 0) {
+            ChunkRule rule;
+            rule.bytes = B * (size_t)size;
+            stream.emplace(a.path, rule.bytes, rule, 2);
+        }
+        struct Round { std::vector<char> window, mine; std::vector<int> counts, displs; MPI_Request req = MPI_REQUEST_NULL; };
+        Round rs[2];
+        // Starts the next round into 'r'; false (on every rank) at end of input.
+        auto post = [&](Round& r) {
+            std::vector<uint64_t> hdr(2 * (size_t)size, 0); // {more, bytes} per rank
+            if (rank == 0) {
+                bool more = false;
+                {
+                    PhaseTimer timer(PH_READ);
+                    more = stream->pop(r.window);
+                }
+                std::vector<size_t> c(size, 0), d(size, 0);
+                if (more) whitespace_cuts(r.window, size, c, d);
+                r.counts.assign(c.begin(), c.end());
+                r.displs.assign(d.begin(), d.end());
+                for (int q = 0; q < size; ++q) {
+                    hdr[2 * q] = more;
+                    hdr[2 * q + 1] = c[q];
+                    sendcounts[q] += c[q];
+                    if (q) stats().bytes_sent += c[q];
+                }
+            }
+            uint64_t mine[2];
+            PhaseTimer timer(PH_SCATTER);
+            MPI_Scatter(hdr.data(), 2, MPI_UINT64_T, mine, 2, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+            if (!mine[0]) return false;
+            r.mine.resize(mine[1]);
+            if (rank) stats().bytes_recv += mine[1];
+            MPI_Iscatterv(r.window.data(), r.counts.data(), r.displs.data(), MPI_CHAR,
+                          r.mine.data(), (int)mine[1], MPI_CHAR, 0, MPI_COMM_WORLD, &r.req);
+            return true;
+        };
+        int cur = 0;
+        for (bool have = post(rs[0]); have; cur ^= 1) {
+            Round& r = rs[cur];
+            const bool next = post(rs[cur ^ 1]);
+            {
+                PhaseTimer timer(PH_SCATTER);
+                MPI_Wait(&r.req, MPI_STATUS_IGNORE);
+            }
+            pending = next ? &rs[cur ^ 1].req : nullptr;
+            count_polling(r.mine.data(), r.mine.size());
+            ship();
+            ++rounds;
+            have = next;
+        }
+    }
+
+    // --- the partials still in flight, then the usual finish ---
+    const uint64_t expect = tree || (!shuffle && rank != 0) ? 0 : rounds * (uint64_t)(size - 1);
+    while (received < expect) {
+        MPI_Status st;
+        {
+            PhaseTimer timer(PH_WAIT);
+            MPI_Probe(MPI_ANY_SOURCE, TAG_PIPE, MPI_COMM_WORLD, &st);
+        }
+        recv_part(st);
+    }
+    {
+        PhaseTimer timer(PH_COMM);
+        sends.wait_all();
+    }
+    if (merger) merger->finish();
+    Counter& global = tree ? part : merged;
+    if (tree) reduce_counts(global, "tree", -1, MPI_COMM_WORLD);
+    else if (shuffle) reduce_shards(global, reduce_top(a), MPI_COMM_WORLD);
+    stats().note_table(global.size());
 
     if (rank == 0) {
-        Counter global;
-        // merge self
-        merge_into(global, local);
-        // merge others
-        for (int r = 1; r < size; ++r) {
-            if (sizes[r] == 0) continue;
-            Counter tmp;
-            deserialize_counter(recvbuf.data() + disps[r], sizes[r], tmp);
-            merge_into(global, tmp);
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        std::cerr << "\n[static] pipelined: " << rounds << " round(s) of ~" << B << "B per rank\n";
+        print_static_bytes(sendcounts, a.bar_width);
+
+        finish_run(global, a, "static", ms);
+    }
+}
+
+void run_static(const Args& a, int rank, int size) {
+    auto t0 = std::chrono::steady_clock::now();
+    if (a.multi_input) { run_static_files(a, rank, size, t0); return; }
+    if (a.pipeline) { run_static_pipeline(a, rank, size, t0); return; }
+    if (a.stream) { run_static_stream(a, rank, size, t0); return; }
+    if (a.node_aware) { run_static_node_aware(a, rank, size, t0); return; }
+
+    std::vector<size_t> sendcounts(size, 0), displs(size, 0);
+    std::vector<char> filebuf;
+    std::vector<char> mychunk;
+    std::optional<MappedFile> mapped;
+    const char* mydata = nullptr;
+    size_t mylen = 0;
+
+    if (a.ingest == "mmap") {
+        // --------------------------------------------------------------------
+        // Parallel ingest: every rank maps the corpus from shared storage and
+        // reads only its own range. No file bytes pass through rank 0.
+        // --------------------------------------------------------------------
+        PhaseTimer timer(PH_READ);
+        mapped.emplace(a.path);
+
+        size_t lo = 0, hi = 0;
+        mmap_range(*mapped, rank, size, MPI_COMM_WORLD, lo, hi);
+
+        mydata = mapped->data() + lo;
+        mylen = hi - lo;
+        mapped->advise_sequential(lo, hi);
+
+        // Rank 0 only needs the sizes for the dashboard.
+        uint64_t mycount = mylen;
+        MPI_Gather(&mycount, 1, MPI_UINT64_T, sendcounts.data(), 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    } else {
+        if (rank == 0) {
+            PhaseTimer timer(PH_READ);
+            filebuf = slurp_file(a.path);
+            whitespace_cuts(filebuf, size, sendcounts, displs);
         }
 
+        PhaseTimer timer(PH_SCATTER);
+        uint64_t mycount = 0;
+        // ------------------------------------------------------------------------
+        // (1) MPI_Scatter
+        // ------------------------------------------------------------------------
+        // Distribute the number of bytes each rank should process.
+        // Rank 0 sends one 64-bit size (sendcounts[r]) to each rank.
+        // Every rank receives its own 'mycount' (local chunk size).
+        // Effectively, each process learns how many bytes it will receive next.
+        MPI_Scatter(sendcounts.data(), 1, MPI_UINT64_T, &mycount, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+        mychunk.resize(mycount);
+        // ------------------------------------------------------------------------
+        // (2) MPI_Scatterv
+        // ------------------------------------------------------------------------
+        // Distribute the actual file data.
+        //
+        // - On rank 0: 'filebuf' contains the entire file.
+        //   The 'sendcounts' array defines how many bytes go to each rank.
+        //   The 'displs' array defines the starting offset for each rank’s data.
+        //
+        // - On all other ranks: the receive buffer 'mychunk' will be filled with
+        //   exactly 'mycount' bytes assigned to that process.
+        //
+        // Result: Each rank now has its local text segment to process independently.
+        // scatterv_bytes (comm.hpp) is a plain MPI_Scatterv while every slice fits an
+        // int count, and falls back to split point-to-point transfers past 1 GiB.
+        scatterv_bytes(rank == 0 ? filebuf.data() : nullptr, sendcounts, displs,
+                       mychunk.data(), mycount, 0, MPI_COMM_WORLD);
+        mydata = mychunk.data();
+        mylen = mychunk.size();
+    }
+
+    if (a.approx) {
+        // --approx: fixed-size summaries instead of exact counts (see sketch.hpp)
+        Summary sum(a.approx, a.cms_width, a.cms_depth);
+        summarize_chunk_omp(mydata, mylen, omp_get_max_threads(), sum);
+        reduce_summary(sum, MPI_COMM_WORLD);
+        if (rank == 0) {
+            auto t1 = std::chrono::steady_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+            print_static_bytes(sendcounts, a.bar_width);
+
+            std::cout << "\nTop " << a.topN << " words (static, approximate):\n";
+            print_approx_topN(sum, approx_topN(sum, a.topN));
+            std::cout << "\nTime: " << ms << " ms\n";
+        }
+        return;
+    }
+
+    // OpenMP counting
+    Counter local = count_chunk_omp(mydata, mylen, omp_get_max_threads());
+
+    // Reduce partial counts to rank 0 (--reduce gather | tree | shuffle, see reduce.hpp)
+    reduce_counts(local, a.reduce, reduce_top(a), MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        const Counter& global = local;
+
         auto t1 = std::chrono::steady_clock::now();
         double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
 
         print_static_bytes(sendcounts, a.bar_width);
 
-        auto top = topN(global, a.topN);
-        std::cout << "\nTop " << a.topN << " words (static):\n";
-        print_topN(top);
-        std::cout << "\nTime: " << ms << " ms\n";
+        finish_run(global, a, "static", ms);
     }
 }
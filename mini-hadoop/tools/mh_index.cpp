@@ -0,0 +1,94 @@
+// Queries a count index written with --index (see include/index.hpp) straight from
+// the mmapped file, without MPI.
+//
+//   build/mh_index <index> top [N]          the N most frequent keys (default 20)
+//   build/mh_index <index> get KEY...       the count of each KEY (0 if absent)
+//   build/mh_index <index> prefix P [N]     the N most frequent keys starting with P
+//   build/mh_index <index> info             key settings, sizes and counted sources
+//
+// KEY and P are tokenized the way the index was counted, so "The  Cat" finds the
+// bigram "the cat" in an ascii --ngram 2 index.
+
+#include "index.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string normalize(const CountIndex& idx, const std::string& q) {
+    std::string key;
+    tokenize_as((TokenizerKind)idx.meta().tokenizer, q.data(), q.size(), [&](const char* t, size_t n) {
+        if (!key.empty()) key += ' ';
+        key.append(t, n);
+    });
+    return key;
+}
+
+int usage(const char* argv0) {
+    std::cerr << "Usage:\n"
+              << "  " << argv0 << " <index> top [N]\n"
+              << "  " << argv0 << " <index> get KEY...\n"
+              << "  " << argv0 << " <index> prefix P [N]\n"
+              << "  " << argv0 << " <index> info\n";
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) return usage(argv[0]);
+    const std::string cmd = argv[2];
+    try {
+        auto t0 = std::chrono::steady_clock::now();
+        CountIndex idx(argv[1]);
+        std::vector<std::pair<std::string, uint64_t>> rows;
+
+        if (cmd == "top") {
+            size_t n = argc > 3 ? std::stoull(argv[3]) : 20;
+            for (size_t r = 0; r < std::min(n, idx.size()); ++r) {
+                size_t i = idx.by_count(r);
+                rows.emplace_back(std::string(idx.key(i)), idx.count(i));
+            }
+        } else if (cmd == "get") {
+            for (int k = 3; k < argc; ++k) {
+                std::string key = normalize(idx, argv[k]);
+                rows.emplace_back(key, idx.get(key));
+            }
+        } else if (cmd == "prefix" && argc > 3) {
+            size_t n = argc > 4 ? std::stoull(argv[4]) : 20;
+            std::string p = normalize(idx, argv[3]);
+            auto [first, last] = idx.prefix_range(p);
+            std::vector<size_t> hits;
+            for (size_t i = first; i < last; ++i) hits.push_back(i);
+            auto by_count = [&](size_t a, size_t b) { return idx.count(a) > idx.count(b); };
+            if (hits.size() > n) {
+                std::partial_sort(hits.begin(), hits.begin() + (long)n, hits.end(), by_count);
+                hits.resize(n);
+            } else {
+                std::stable_sort(hits.begin(), hits.end(), by_count);
+            }
+            for (size_t i : hits) rows.emplace_back(std::string(idx.key(i)), idx.count(i));
+        } else if (cmd == "info") {
+            const IndexMeta& m = idx.meta();
+            std::cout << "keys:    " << idx.size() << "\n"
+                      << "total:   " << idx.total() << "\n"
+                      << "counted: " << m.describe() << "\n"
+                      << "sources: " << m.sources.size() << "\n";
+            for (auto& s : m.sources) std::cout << "  " << s.path << "  " << s.size << "B\n";
+            return 0;
+        } else {
+            return usage(argv[0]);
+        }
+
+        print_topN(rows);
+        auto t1 = std::chrono::steady_clock::now();
+        std::cerr << "(" << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms)\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}